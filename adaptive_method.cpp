@@ -0,0 +1,531 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdlib.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <unistd.h>
+
+// Picks the fork acquisition strategy at run time instead of by file:
+//   ordering     lower-numbered fork first (chandy_misra_method.cpp)
+//   retry        left then right with a timeout, back off on failure (deadlock.cpp)
+//   waiter       both forks or none from a central waiter (waiter_method.cpp)
+// A selector thread samples hunger ratio, failed acquisitions and wait times
+// and switches strategy once nobody holds or waits for a fork.
+//
+// Usage: adaptive_method [-f ordering|retry|waiter] [-d seconds] [-e eat_ms]
+//                        [-i idle_think_ms] [-b busy_think_ms] [-p period_ms] [-s sample_ms]
+//   -f  pin one strategy, for comparison with the adaptive run
+//   -i/-b/-p  thinking time alternates between idle and busy every period
+
+
+std::ostream&
+print_one(std::ostream& os)
+{
+    return os;
+}
+
+template <class A0, class ...Args>
+std::ostream&
+print_one(std::ostream& os, const A0& a0, const Args& ...args)
+{
+    os << a0;
+    return print_one(os, args...);
+}
+
+template <class ...Args>
+std::ostream&
+print(std::ostream& os, const Args& ...args)
+{
+    return print_one(os, args...);
+}
+
+std::mutex&
+get_cout_mutex()
+{
+    static std::mutex m;
+    return m;
+}
+
+template <class ...Args>
+std::ostream&
+print(const Args& ...args)
+{
+    std::lock_guard<std::mutex> _(get_cout_mutex());
+    return print(std::cout, args...);
+}
+
+using Clock = std::chrono::steady_clock;
+
+enum class Strategy { Ordering, TimedRetry, Waiter };
+constexpr std::size_t num_strategies = 3;
+
+const char* to_string(Strategy s)
+{
+    switch (s)
+    {
+    case Strategy::Ordering: return "ordering";
+    case Strategy::TimedRetry: return "retry";
+    case Strategy::Waiter: return "waiter";
+    }
+    return "?";
+}
+
+struct Fork
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool isTaken = false;
+
+    void takeFork()
+    {
+        isTaken = true;
+        cv.notify_one();
+    }
+
+    void putFork()
+    {
+        isTaken = false;
+        cv.notify_one();
+    }
+};
+
+// Hands out both forks or none, like request_forks in waiter_method.c. While
+// this strategy is active the forks' isTaken flags are only touched under the
+// waiter's mutex.
+struct Waiter
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    void takeForks(Fork& left, Fork& right)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [&] { return !left.isTaken && !right.isTaken; });
+        left.isTaken = true;
+        right.isTaken = true;
+    }
+
+    void putForks(Fork& left, Fork& right)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            left.isTaken = false;
+            right.isTaken = false;
+        }
+        cv.notify_all();
+    }
+};
+
+// Philosophers enter the gate before touching forks and leave it after putting
+// them back. A switch closes the gate and waits until nobody is inside, so no
+// fork is ever held under one strategy and released under another. Outside a
+// switch entering and leaving is one atomic add each; the mutex is only
+// taken while a switch is in progress.
+class Gate
+{
+public:
+    explicit Gate(Strategy initial) : strategy(initial) {}
+
+    Strategy enter()
+    {
+        for (;;)
+        {
+            // Pairs with switchTo: of the increment and the switching store,
+            // at least one side sees the other.
+            inFlight.fetch_add(1);
+            if (!switching.load())
+                return strategy.load(std::memory_order_relaxed);
+            leave();
+
+            std::unique_lock<std::mutex> lk(mutex);
+            cv.wait(lk, [this] { return !switching.load(); });
+        }
+    }
+
+    void leave()
+    {
+        if (inFlight.fetch_sub(1) == 1 && switching.load())
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            cv.notify_all();
+        }
+    }
+
+    void switchTo(Strategy next)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        switching.store(true);
+        cv.wait(lk, [this] { return inFlight.load() == 0; });
+        strategy.store(next, std::memory_order_relaxed);
+        switching.store(false);
+        cv.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<Strategy> strategy;
+    std::atomic<std::size_t> inFlight{0};
+    std::atomic<bool> switching{false};
+};
+
+// Contention signals, reset by the selector at every sample.
+struct Signals
+{
+    std::atomic<long long> hungryNs{0};     // hunger that ended, counted from the last sample at most
+    std::atomic<long long> waitNs{0};
+    // Attempts in the low half, failures in the high half, so that both are
+    // counted and reset together.
+    std::atomic<std::uint64_t> outcomes{0};
+    static constexpr std::uint64_t attempt = 1;
+    static constexpr std::uint64_t failure = attempt << 32;
+};
+
+struct Config
+{
+    bool adaptive = true;
+    Strategy fixed = Strategy::Ordering;
+    std::chrono::seconds duration{10};
+    std::chrono::milliseconds eatTime{5};
+    std::chrono::milliseconds idleThink{50};
+    std::chrono::milliseconds busyThink{0};
+    std::chrono::milliseconds period{2000};
+    std::chrono::milliseconds sample{100};
+    std::chrono::milliseconds retryTimeout{5};
+};
+
+struct Table
+{
+    Config cfg;
+    std::vector<Fork> forks;
+    Waiter waiter;
+    Gate gate;
+    Signals signals;
+    std::vector<std::atomic<long long>> hungrySince;   // ns since opened, -1 while not hungry
+    std::atomic<std::size_t> mealsBy[num_strategies] = {};
+    std::atomic<bool> closing{false};
+    Clock::time_point opened = Clock::now();
+
+    Table(const Config& cfg, std::size_t num_philosophers)
+        : cfg(cfg), forks(num_philosophers), gate(cfg.adaptive ? Strategy::Ordering : cfg.fixed), hungrySince(num_philosophers)
+    {
+        for (auto& since : hungrySince)
+            since = -1;
+    }
+
+    long long sinceOpened(Clock::time_point t) const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t - opened).count();
+    }
+};
+
+class Philosopher
+{
+public:
+    std::size_t name;
+    std::size_t num_philosophers;
+    Fork& leftFork;
+    Fork& rightFork;
+    Table& table;
+
+    Philosopher(std::size_t name, Fork& leftFork, Fork& rightFork, size_t num_philos, Table& table)
+        : name(name), num_philosophers(num_philos), leftFork(leftFork), rightFork(rightFork), table(table)
+    {}
+
+    void action()
+    {
+        while (!table.closing)
+        {
+            think();
+            dine();
+        }
+    }
+
+    void think()
+    {
+        auto phase = (Clock::now() - table.opened) / table.cfg.period;
+        std::this_thread::sleep_for(phase % 2 == 0 ? table.cfg.idleThink : table.cfg.busyThink);
+    }
+
+    void dine()
+    {
+        std::atomic<long long>& hungrySince = table.hungrySince[name - 1];
+        hungrySince = table.sinceOpened(Clock::now());
+        bool ate = false;
+        while (!ate && !table.closing)
+        {
+            Strategy strategy = table.gate.enter();
+            auto start = Clock::now();
+            bool gotForks = takeForks(strategy);
+            auto waited = Clock::now() - start;
+            table.signals.waitNs += waited.count();
+
+            // Ordering and waiter never give up, so a wait that retry would
+            // have timed out on counts as their failure.
+            bool failed = !gotForks || (strategy != Strategy::TimedRetry && waited > table.cfg.retryTimeout);
+            table.signals.outcomes += failed ? Signals::attempt + Signals::failure : Signals::attempt;
+
+            if (gotForks)
+            {
+                // The selector may have moved the start up to its last sample.
+                long long end = table.sinceOpened(Clock::now());
+                table.signals.hungryNs += end - hungrySince.exchange(-1);
+                std::this_thread::sleep_for(table.cfg.eatTime);
+                putForks(strategy);
+                table.mealsBy[static_cast<std::size_t>(strategy)]++;
+                ate = true;
+            }
+            table.gate.leave();
+
+            // Like deadlock.cpp, a philosopher that timed out backs off before trying again.
+            if (!ate)
+                std::this_thread::sleep_for(table.cfg.retryTimeout);
+        }
+        hungrySince = -1;
+    }
+
+private:
+    bool takeForks(Strategy strategy)
+    {
+        switch (strategy)
+        {
+        case Strategy::Ordering:
+        {
+            bool leftIsFirst = name - 1 < name % num_philosophers;
+            Fork& first = leftIsFirst ? leftFork : rightFork;
+            Fork& second = leftIsFirst ? rightFork : leftFork;
+            takeBlocking(first);
+            takeBlocking(second);
+            return true;
+        }
+        case Strategy::TimedRetry:
+        {
+            if (!takeTimed(leftFork))
+                return false;
+            if (!takeTimed(rightFork))
+            {
+                release(leftFork);
+                return false;
+            }
+            return true;
+        }
+        case Strategy::Waiter:
+            table.waiter.takeForks(leftFork, rightFork);
+            return true;
+        }
+        return false;
+    }
+
+    void putForks(Strategy strategy)
+    {
+        if (strategy == Strategy::Waiter)
+        {
+            table.waiter.putForks(leftFork, rightFork);
+            return;
+        }
+        release(leftFork);
+        release(rightFork);
+    }
+
+    void takeBlocking(Fork& fork)
+    {
+        std::unique_lock<std::mutex> lk(fork.mutex);
+        fork.cv.wait(lk, [&] { return !fork.isTaken; });
+        fork.takeFork();
+    }
+
+    bool takeTimed(Fork& fork)
+    {
+        std::unique_lock<std::mutex> lk(fork.mutex);
+        if (!fork.cv.wait_for(lk, table.cfg.retryTimeout, [&] { return !fork.isTaken; }))
+            return false;
+        fork.takeFork();
+        return true;
+    }
+
+    void release(Fork& fork)
+    {
+        std::lock_guard<std::mutex> lk(fork.mutex);
+        fork.putFork();
+    }
+};
+
+struct Sample
+{
+    double hungerRatio;     // share of philosopher time spent hungry
+    double failureRate;     // failed acquisitions, or waits retry would have given up on, per attempt
+    double avgWaitMs;       // time inside takeForks per attempt
+};
+
+// Thresholds come in enter/exit pairs so that a signal hovering around one
+// value does not flip the strategy back and forth.
+struct Policy
+{
+    double idleEnter = 0.05;
+    double idleExit = 0.15;
+    double busyEnter = 0.40;
+    double busyExit = 0.25;
+    double failureEnter = 0.20;
+    double failureExit = 0.10;
+    int confirmSamples = 3;
+
+    // Failure rate that last moved us to the waiter, 0 if hunger did. Leaving
+    // again needs failures to drop to a quarter of it, and below failureExit.
+    double failureAtSwitch = 0.0;
+
+    Strategy propose(const Sample& s, Strategy current) const
+    {
+        double idle = current == Strategy::TimedRetry ? idleExit : idleEnter;
+        double busy = current == Strategy::Waiter ? busyExit : busyEnter;
+        double failure = failureEnter;
+        if (current == Strategy::Waiter)
+            failure = failureAtSwitch > 0 ? std::min(failureExit, failureAtSwitch / 4) : failureExit;
+        if (s.hungerRatio > busy || s.failureRate > failure)
+            return Strategy::Waiter;
+        if (s.hungerRatio < idle)
+            return Strategy::TimedRetry;
+        return Strategy::Ordering;
+    }
+
+    void switched(Strategy to, const Sample& s)
+    {
+        failureAtSwitch = to == Strategy::Waiter && s.failureRate > failureEnter ? s.failureRate : 0.0;
+    }
+};
+
+void select_strategy(Table& table, std::size_t num_philosophers)
+{
+    Policy policy;
+    Strategy current = Strategy::Ordering;
+    Strategy candidate = current;
+    int votes = 0;
+    std::size_t switches = 0;
+
+    auto last = Clock::now();
+    while (!table.closing)
+    {
+        std::this_thread::sleep_for(table.cfg.sample);
+        auto now = Clock::now();
+        double span = std::chrono::duration<double, std::nano>(now - last).count() * num_philosophers;
+        last = now;
+
+        // Philosophers still hungry count up to now; moving their start to now
+        // leaves only the rest of their hunger for the next sample.
+        long long cut = table.sinceOpened(now);
+        long long hungryNs = table.signals.hungryNs.exchange(0);
+        for (auto& since : table.hungrySince)
+        {
+            long long start = since;
+            while (start >= 0 && start < cut && !since.compare_exchange_weak(start, cut))
+                ;
+            if (start >= 0 && start < cut)
+                hungryNs += cut - start;
+        }
+
+        std::uint64_t outcomes = table.signals.outcomes.exchange(0);
+        std::size_t attempts = outcomes % Signals::failure;
+        std::size_t failures = outcomes / Signals::failure;
+        Sample s;
+        s.hungerRatio = std::clamp(hungryNs / span, 0.0, 1.0);
+        s.failureRate = attempts ? double(failures) / attempts : 0.0;
+        s.avgWaitMs = attempts ? table.signals.waitNs.exchange(0) / 1e6 / attempts : 0.0;
+
+        if (!table.cfg.adaptive)
+            continue;
+
+        Strategy proposed = policy.propose(s, current);
+        if (proposed == current)
+        {
+            votes = 0;
+            continue;
+        }
+        votes = proposed == candidate ? votes + 1 : 1;
+        candidate = proposed;
+        if (votes < policy.confirmSamples)
+            continue;
+
+        print("Switching from ", to_string(current), " to ", to_string(proposed),
+              " (hunger ratio ", s.hungerRatio, ", failure rate ", s.failureRate, ", avg wait ", s.avgWaitMs, " ms)\n");
+        table.gate.switchTo(proposed);
+        policy.switched(proposed, s);
+        current = proposed;
+        votes = 0;
+        switches++;
+    }
+    if (table.cfg.adaptive)
+        print(switches, " strategy switches\n");
+}
+
+bool parse_strategy(const std::string& name, Strategy& out)
+{
+    for (std::size_t i = 0; i < num_strategies; ++i)
+    {
+        if (name == to_string(static_cast<Strategy>(i)))
+        {
+            out = static_cast<Strategy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    Config cfg;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:d:e:i:b:p:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            cfg.adaptive = false;
+            if (parse_strategy(optarg, cfg.fixed))
+                break;
+            [[fallthrough]];
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-f ordering|retry|waiter] [-d seconds] [-e eat_ms]"
+                      << " [-i idle_think_ms] [-b busy_think_ms] [-p period_ms] [-s sample_ms]\n";
+            return EXIT_FAILURE;
+        case 'd': cfg.duration = std::chrono::seconds(std::stol(optarg)); break;
+        case 'e': cfg.eatTime = std::chrono::milliseconds(std::stol(optarg)); break;
+        case 'i': cfg.idleThink = std::chrono::milliseconds(std::stol(optarg)); break;
+        case 'b': cfg.busyThink = std::chrono::milliseconds(std::stol(optarg)); break;
+        case 'p': cfg.period = std::chrono::milliseconds(std::max(1L, std::stol(optarg))); break;
+        case 's': cfg.sample = std::chrono::milliseconds(std::max(1L, std::stol(optarg))); break;
+        }
+    }
+
+    const std::size_t num_philosophers = 5;
+    Table table(cfg, num_philosophers);
+    std::vector<Philosopher> philosophers;
+
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+        philosophers.emplace_back(i + 1, table.forks[i], table.forks[(i + 1) % num_philosophers], num_philosophers, table);
+
+    std::vector<std::thread> threads;
+    for (auto& philosopher : philosophers)
+        threads.emplace_back(&Philosopher::action, &philosopher);
+    std::thread selector(select_strategy, std::ref(table), num_philosophers);
+
+    std::this_thread::sleep_for(cfg.duration);
+    table.closing = true;
+
+    for (auto& thread : threads)
+        thread.join();
+    selector.join();
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < num_strategies; ++i)
+    {
+        print("Meals with ", to_string(static_cast<Strategy>(i)), ": ", table.mealsBy[i].load(), "\n");
+        total += table.mealsBy[i];
+    }
+    print("Total: ", total, " meals in ", cfg.duration.count(), " s\n");
+}
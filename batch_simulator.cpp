@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Monte-Carlo simulation of many independent five-seat tables at once.
+//
+// The state is bit-sliced: every variable (philosopher i is hungry, fork f is
+// taken, ...) is one bit per table, and a Lanes vector packs that bit for 256
+// tables. One pass of bitwise operations therefore advances 256 tables by one
+// time step. Thinking and dining last a geometric number of steps.
+//
+// Usage: batch_simulator [-t tables] [-s steps] [-h hunger_chance] [-e finish_chance] [-j threads] [-r seed]
+//   -h  chance per step that a thinking philosopher gets hungry
+//   -e  chance per step that a dining philosopher finishes
+// Chances are rounded to multiples of 1/256.
+// Build with -O3 -march=native so that Lanes maps onto AVX2 registers.
+
+constexpr std::size_t num_philosophers = 5;
+constexpr std::size_t words = 4;
+constexpr std::size_t tables_per_block = 64 * words;
+constexpr std::size_t counter_bits = 8;
+// A philosopher finishes at most one meal per step, so flushing this often
+// keeps the 8-bit sliced meal counters from overflowing.
+constexpr std::size_t flush_interval = 255;
+
+typedef std::uint64_t Lanes __attribute__((vector_size(words * sizeof(std::uint64_t))));
+
+enum class Strategy
+{
+    Ordering,   // take the lower-numbered fork first (chandy_misra_method.cpp, datarace.cpp)
+    Waiter      // take both forks or none (request_forks in waiter_method.c)
+};
+
+std::uint64_t splitmix64(std::uint64_t& x)
+{
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// xorshift128+ running independently in every 64-bit lane.
+struct Rng
+{
+    Lanes s0;
+    Lanes s1;
+
+    explicit Rng(std::uint64_t seed)
+    {
+        for (std::size_t w = 0; w < words; ++w)
+        {
+            s0[w] = splitmix64(seed);
+            s1[w] = splitmix64(seed);
+        }
+    }
+
+    Lanes next()
+    {
+        Lanes x = s0;
+        const Lanes y = s1;
+        s0 = y;
+        x ^= x << 23;
+        s1 = x ^ y ^ (x >> 17) ^ (y >> 26);
+        return s1 + y;
+    }
+
+    // Every bit is set with probability p / 256: compares a random 8-bit
+    // number per bit against p, most significant bit first.
+    Lanes chance(unsigned p)
+    {
+        const Lanes zero = {};
+        if (p == 0)
+            return zero;
+        if (p >= 256)
+            return ~zero;
+
+        Lanes less = zero;
+        Lanes equal = ~zero;
+        for (int bit = counter_bits - 1; bit >= 0 && (p & ((2u << bit) - 1)); --bit)
+        {
+            const Lanes r = next();
+            if (p & (1u << bit))
+            {
+                less |= equal & ~r;
+                equal &= r;
+            }
+            else
+            {
+                equal &= ~r;
+            }
+        }
+        return less;
+    }
+};
+
+std::size_t popcount(const Lanes& v)
+{
+    std::size_t n = 0;
+    for (std::size_t w = 0; w < words; ++w)
+        n += __builtin_popcountll(v[w]);
+    return n;
+}
+
+struct Block
+{
+    std::array<Lanes, num_philosophers> hungry{};
+    std::array<Lanes, num_philosophers> eating{};
+    std::array<Lanes, num_philosophers> holdsFirst{};  // Ordering: has the first fork, waits for the second
+    std::array<Lanes, num_philosophers> taken{};
+    std::array<std::array<Lanes, counter_bits>, num_philosophers> meals{};
+    Rng rng;
+
+    explicit Block(std::uint64_t seed) : rng(seed) {}
+
+    void countMeal(std::size_t i, Lanes carry)
+    {
+        for (auto& plane : meals[i])
+        {
+            const Lanes next = plane & carry;
+            plane ^= carry;
+            carry = next;
+        }
+    }
+
+    // Adds the sliced counters to the per-table totals and clears them.
+    void flush(std::uint32_t* totals)
+    {
+        for (std::size_t i = 0; i < num_philosophers; ++i)
+        {
+            for (std::size_t w = 0; w < words; ++w)
+            {
+                for (std::size_t b = 0; b < 64; ++b)
+                {
+                    std::uint32_t value = 0;
+                    for (std::size_t bit = 0; bit < counter_bits; ++bit)
+                        value |= ((meals[i][bit][w] >> b) & 1) << bit;
+                    totals[(w * 64 + b) * num_philosophers + i] += value;
+                }
+            }
+            meals[i] = {};
+        }
+    }
+};
+
+std::size_t left(std::size_t i) { return i; }
+std::size_t right(std::size_t i) { return (i + 1) % num_philosophers; }
+std::size_t previous(std::size_t i) { return (i + num_philosophers - 1) % num_philosophers; }
+
+// Fork f is wanted by philosopher f as its left fork and by philosopher f - 1
+// as its right fork. When both ask in the same step a coin decides; the grants
+// are returned in the same left/right layout as the wants.
+void grant(Block& b, const std::array<Lanes, num_philosophers>& wantLeft, const std::array<Lanes, num_philosophers>& wantRight,
+           std::array<Lanes, num_philosophers>& gotLeft, std::array<Lanes, num_philosophers>& gotRight)
+{
+    for (std::size_t f = 0; f < num_philosophers; ++f)
+    {
+        const Lanes a = wantLeft[f];
+        const Lanes c = wantRight[previous(f)];
+        const Lanes free = ~b.taken[f];
+        const Lanes coin = b.rng.next();
+        gotLeft[f] = a & free & (~c | coin);
+        gotRight[previous(f)] = c & free & (~a | ~coin);
+        b.taken[f] |= gotLeft[f] | gotRight[previous(f)];
+    }
+}
+
+void acquireOrdered(Block& b)
+{
+    std::array<Lanes, num_philosophers> wantLeft, wantRight, gotLeft, gotRight;
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+    {
+        const Lanes wantFirst = b.hungry[i] & ~b.holdsFirst[i];
+        const Lanes wantSecond = b.holdsFirst[i];
+        // The lower-numbered fork is the left one for everybody but the last philosopher.
+        const bool leftIsFirst = left(i) < right(i);
+        wantLeft[i] = leftIsFirst ? wantFirst : wantSecond;
+        wantRight[i] = leftIsFirst ? wantSecond : wantFirst;
+    }
+
+    grant(b, wantLeft, wantRight, gotLeft, gotRight);
+
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+    {
+        const bool leftIsFirst = left(i) < right(i);
+        const Lanes gotFirst = leftIsFirst ? gotLeft[i] : gotRight[i];
+        const Lanes gotSecond = leftIsFirst ? gotRight[i] : gotLeft[i];
+        b.holdsFirst[i] = (b.holdsFirst[i] | gotFirst) & ~gotSecond;
+        b.eating[i] |= gotSecond;
+        b.hungry[i] &= ~gotSecond;
+    }
+}
+
+void acquireBoth(Block& b)
+{
+    const Lanes zero = {};
+    std::array<Lanes, num_philosophers> can, start, granted{};
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+        can[i] = b.hungry[i] & ~b.taken[left(i)] & ~b.taken[right(i)];
+
+    // A random starting seat per table: seat s with chance 1 / (seats left).
+    Lanes rest = ~zero;
+    for (std::size_t s = 0; s + 1 < num_philosophers; ++s)
+    {
+        start[s] = rest & b.rng.chance(256 / (num_philosophers - s));
+        rest &= ~start[s];
+    }
+    start[num_philosophers - 1] = rest;
+
+    // Like request_forks behind the waiter's mutex, walk the seats from the
+    // start and grant everybody whose two forks are still free. Pass k visits
+    // seat k % 5 in the tables whose walk started at most four seats earlier.
+    for (std::size_t k = 0; k < 2 * num_philosophers - 1; ++k)
+    {
+        const std::size_t i = k % num_philosophers;
+        Lanes visiting = zero;
+        for (std::size_t s = 0; s < num_philosophers; ++s)
+        {
+            if (s <= k && k < s + num_philosophers)
+                visiting |= start[s];
+        }
+        granted[i] |= visiting & can[i] & ~granted[previous(i)] & ~granted[right(i)];
+    }
+
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+    {
+        b.taken[left(i)] |= granted[i];
+        b.taken[right(i)] |= granted[i];
+        b.eating[i] |= granted[i];
+        b.hungry[i] &= ~granted[i];
+    }
+}
+
+struct Config
+{
+    std::size_t tables = 1 << 16;
+    std::size_t steps = 10000;
+    unsigned hungerChance = 26;     // ~0.1
+    unsigned finishChance = 51;     // ~0.2
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::uint64_t seed = 1;
+};
+
+// Returns the number of philosopher-steps spent hungry.
+std::uint64_t simulate(const Config& cfg, Strategy strategy, std::size_t block, std::uint32_t* totals)
+{
+    std::uint64_t seed = cfg.seed ^ (block * 0x2545f4914f6cdd1dULL) ^ (strategy == Strategy::Waiter ? 0xabcdefULL : 0);
+    Block b(seed);
+    std::uint64_t hungrySteps = 0;
+
+    for (std::size_t step = 1; step <= cfg.steps; ++step)
+    {
+        for (std::size_t i = 0; i < num_philosophers; ++i)
+        {
+            const Lanes done = b.eating[i] & b.rng.chance(cfg.finishChance);
+            b.eating[i] &= ~done;
+            b.taken[left(i)] &= ~done;
+            b.taken[right(i)] &= ~done;
+            b.countMeal(i, done);
+
+            const Lanes thinking = ~(b.hungry[i] | b.eating[i]);
+            b.hungry[i] |= thinking & b.rng.chance(cfg.hungerChance);
+        }
+
+        if (strategy == Strategy::Ordering)
+            acquireOrdered(b);
+        else
+            acquireBoth(b);
+
+        for (std::size_t i = 0; i < num_philosophers; ++i)
+            hungrySteps += popcount(b.hungry[i]);
+
+        if (step % flush_interval == 0)
+            b.flush(totals);
+    }
+    b.flush(totals);
+    return hungrySteps;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5))];
+}
+
+void report(const char* name, const Config& cfg, const std::vector<std::uint32_t>& totals, std::uint64_t hungrySteps, double seconds)
+{
+    std::vector<double> throughput, jain, minMax;
+    std::uint64_t meals = 0;
+    for (std::size_t t = 0; t < cfg.tables; ++t)
+    {
+        const std::uint32_t* m = &totals[t * num_philosophers];
+        double sum = 0, squares = 0, lo = m[0], hi = m[0];
+        for (std::size_t i = 0; i < num_philosophers; ++i)
+        {
+            sum += m[i];
+            squares += double(m[i]) * m[i];
+            lo = std::min<double>(lo, m[i]);
+            hi = std::max<double>(hi, m[i]);
+        }
+        meals += sum;
+        throughput.push_back(sum * 1000 / cfg.steps);
+        jain.push_back(squares > 0 ? sum * sum / (num_philosophers * squares) : 1.0);
+        minMax.push_back(hi > 0 ? lo / hi : 1.0);
+    }
+    std::sort(throughput.begin(), throughput.end());
+    std::sort(jain.begin(), jain.end());
+    std::sort(minMax.begin(), minMax.end());
+
+    auto row = [](const char* label, const std::vector<double>& v)
+    {
+        std::cout << "  " << std::left << std::setw(28) << label << std::right
+                  << " p1 " << std::setw(8) << percentile(v, 0.01)
+                  << "  p50 " << std::setw(8) << percentile(v, 0.50)
+                  << "  p99 " << std::setw(8) << percentile(v, 0.99) << "\n";
+    };
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << name << ": " << cfg.tables << " tables x " << cfg.steps << " steps in " << seconds << " s ("
+              << std::setprecision(1) << cfg.tables * double(cfg.steps) / seconds / 1e6 << "M table-steps/s)\n"
+              << std::setprecision(3);
+    row("meals per 1000 steps", throughput);
+    row("Jain fairness index", jain);
+    row("min/max meals per seat", minMax);
+    std::cout << "  mean hungry steps per meal  " << (meals ? double(hungrySteps) / meals : 0.0) << "\n";
+}
+
+void run(const Config& cfg, Strategy strategy, const char* name)
+{
+    const std::size_t blocks = cfg.tables / tables_per_block;
+    std::vector<std::uint32_t> totals(cfg.tables * num_philosophers, 0);
+    std::vector<std::uint64_t> hungry(cfg.threads, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < cfg.threads; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            for (std::size_t block = t; block < blocks; block += cfg.threads)
+                hungry[t] += simulate(cfg, strategy, block, &totals[block * tables_per_block * num_philosophers]);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::uint64_t hungrySteps = 0;
+    for (auto h : hungry)
+        hungrySteps += h;
+    report(name, cfg, totals, hungrySteps, elapsed.count());
+}
+
+int main(int argc, char* argv[])
+{
+    Config cfg;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:h:e:j:r:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': cfg.tables = std::stoul(optarg); break;
+        case 's': cfg.steps = std::stoul(optarg); break;
+        case 'h': cfg.hungerChance = static_cast<unsigned>(std::lround(std::stod(optarg) * 256)); break;
+        case 'e': cfg.finishChance = static_cast<unsigned>(std::lround(std::stod(optarg) * 256)); break;
+        case 'j': cfg.threads = std::max(1, std::stoi(optarg)); break;
+        case 'r': cfg.seed = std::stoull(optarg); break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-t tables] [-s steps] [-h hunger_chance] [-e finish_chance] [-j threads] [-r seed]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    cfg.tables = std::max(tables_per_block, (cfg.tables + tables_per_block - 1) / tables_per_block * tables_per_block);
+
+    run(cfg, Strategy::Ordering, "Resource ordering");
+    run(cfg, Strategy::Waiter, "Waiter (both or nothing)");
+}
@@ -0,0 +1,515 @@
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+// Chandy-Misra with every philosopher in its own process. There is no shared
+// memory between philosophers: each fork is a connection between the two
+// neighbours that share it, and forks and request tokens travel over it as
+// messages. Every node runs an epoll loop over its two fork connections and a
+// timerfd that ends thinking and dining.
+//
+// Usage: chandy_misra_distributed [-n philosophers] [-m meals] [-d max_delay_ms] [-t] [-q]
+//   -n  number of philosophers / processes (at least 2)
+//   -m  meals per philosopher before the table shuts down
+//   -d  upper bound for the random thinking/dining time, 0 for back-to-back meals
+//   -t  connect neighbours over loopback TCP instead of Unix-domain socket pairs
+//   -q  only print the summary
+
+#define DEFAULT_PHILOSOPHERS 5
+#define BUFFER_SIZE 4096
+#define MAX_EVENTS 4
+
+enum MessageType
+{
+    REQUEST = 1,    // carries the request token for a fork
+    FORK = 2,       // carries the (clean) fork itself
+    DONE = 3        // sender has finished all its meals and will not request again
+};
+
+#pragma pack(push, 1)
+typedef struct
+{
+    uint8_t type;
+    uint16_t fork;
+    int64_t sentAt;     // CLOCK_MONOTONIC, comparable between processes on one host
+} Message;
+#pragma pack(pop)
+
+enum State
+{
+    THINKING,
+    HUNGRY,
+    EATING,
+    FINISHED
+};
+
+enum { LEFT, RIGHT };
+
+typedef struct
+{
+    int sock;
+    size_t fork;
+    bool haveFork;
+    bool dirty;
+    bool haveToken;
+    bool peerDone;
+    bool waitingWritable;
+    char out[BUFFER_SIZE];
+    size_t outLen;
+    char in[BUFFER_SIZE];
+    size_t inLen;
+} Side;
+
+typedef struct
+{
+    unsigned long meals;
+    unsigned long messagesSent;
+    unsigned long writes;
+    unsigned long handoffs;
+    unsigned long long handoffNs;
+    unsigned long long hungryNs;
+} Stats;
+
+typedef struct
+{
+    size_t name;
+    enum State state;
+    Side sides[2];
+    int timer;
+    int epoll;
+    long long hungrySince;
+    Stats* stats;
+} Node;
+
+size_t num_philosophers = DEFAULT_PHILOSOPHERS;
+unsigned long meals_limit = 1000;
+int max_delay_ms = 0;
+bool use_tcp = false;
+bool quiet = false;
+
+long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void print(const char* format, ...)
+{
+    if (quiet)
+        return;
+    // One write per line keeps lines from different processes intact.
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > 0)
+        write(STDOUT_FILENO, line, len < (int)sizeof(line) ? (size_t)len : sizeof(line) - 1);
+}
+
+void die(const char* what)
+{
+    perror(what);
+    exit(EXIT_FAILURE);
+}
+
+// Messages are only queued here; flush() sends everything queued for a side
+// with a single write once the current batch of events has been handled.
+void send_message(Node* node, Side* side, uint8_t type)
+{
+    Message msg = { .type = type, .fork = (uint16_t)side->fork, .sentAt = now_ns() };
+    if (side->outLen + sizeof(msg) > sizeof(side->out))
+    {
+        fprintf(stderr, "Philosopher %zu: outgoing buffer overflow\n", node->name + 1);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(side->out + side->outLen, &msg, sizeof(msg));
+    side->outLen += sizeof(msg);
+    node->stats->messagesSent++;
+}
+
+void flush(Node* node, Side* side)
+{
+    if (side->outLen == 0)
+        return;
+
+    ssize_t n = send(side->sock, side->out, side->outLen, MSG_NOSIGNAL);
+    if (n < 0 && errno != EAGAIN)
+        die("write");
+    if (n > 0)
+    {
+        node->stats->writes++;
+        memmove(side->out, side->out + n, side->outLen - n);
+        side->outLen -= n;
+    }
+
+    bool wantWritable = side->outLen > 0;
+    if (wantWritable != side->waitingWritable)
+    {
+        struct epoll_event ev = { .events = EPOLLIN | (wantWritable ? EPOLLOUT : 0), .data.ptr = side };
+        epoll_ctl(node->epoll, EPOLL_CTL_MOD, side->sock, &ev);
+        side->waitingWritable = wantWritable;
+    }
+}
+
+void arm_timer(Node* node)
+{
+    long long delay = max_delay_ms > 0 ? (long long)(rand() % (max_delay_ms + 1)) * 1000000LL : 0;
+    // A zero it_value would disarm the timer, so "no delay" still goes through epoll.
+    if (delay == 0)
+        delay = 1;
+    struct itimerspec its = { .it_value = { .tv_sec = delay / 1000000000LL, .tv_nsec = delay % 1000000000LL } };
+    timerfd_settime(node->timer, 0, &its, NULL);
+}
+
+void send_fork(Node* node, Side* side)
+{
+    side->haveFork = false;
+    side->dirty = false;
+    send_message(node, side, FORK);
+}
+
+void try_eat(Node* node)
+{
+    if (node->state != HUNGRY || !node->sides[LEFT].haveFork || !node->sides[RIGHT].haveFork)
+        return;
+
+    node->stats->hungryNs += now_ns() - node->hungrySince;
+    node->state = EATING;
+    print("Philosopher %zu is dining. So he took fork #%zu and #%zu\n", node->name + 1, node->sides[LEFT].fork, node->sides[RIGHT].fork);
+    arm_timer(node);
+}
+
+void become_hungry(Node* node)
+{
+    node->state = HUNGRY;
+    node->hungrySince = now_ns();
+    print("Philosopher %zu is hungry.\n", node->name + 1);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        Side* side = &node->sides[i];
+        if (!side->haveFork && side->haveToken)
+        {
+            side->haveToken = false;
+            send_message(node, side, REQUEST);
+        }
+    }
+    try_eat(node);
+}
+
+void finish_eating(Node* node)
+{
+    node->stats->meals++;
+    print("Philosopher %zu finished dining.\n", node->name + 1);
+
+    // After eating both forks are dirty, and any neighbour that already asked gets its fork now.
+    for (int i = 0; i < 2; ++i)
+    {
+        Side* side = &node->sides[i];
+        side->dirty = true;
+        if (side->haveToken)
+            send_fork(node, side);
+    }
+
+    if (node->stats->meals >= meals_limit)
+    {
+        node->state = FINISHED;
+        send_message(node, &node->sides[LEFT], DONE);
+        send_message(node, &node->sides[RIGHT], DONE);
+        return;
+    }
+
+    node->state = THINKING;
+    print("Philosopher %zu is thinking.\n", node->name + 1);
+    arm_timer(node);
+}
+
+void handle_message(Node* node, Side* side, const Message* msg)
+{
+    switch (msg->type)
+    {
+    case REQUEST:
+        side->haveToken = true;
+        // A dirty fork is handed over unless we are eating with it; a clean one is kept.
+        if (side->haveFork && side->dirty && node->state != EATING)
+        {
+            send_fork(node, side);
+            if (node->state == HUNGRY)
+            {
+                side->haveToken = false;
+                send_message(node, side, REQUEST);
+            }
+        }
+        break;
+    case FORK:
+        side->haveFork = true;
+        side->dirty = false;
+        node->stats->handoffs++;
+        node->stats->handoffNs += now_ns() - msg->sentAt;
+        try_eat(node);
+        break;
+    case DONE:
+        side->peerDone = true;
+        break;
+    default:
+        fprintf(stderr, "Philosopher %zu: unknown message type %u\n", node->name + 1, msg->type);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void receive(Node* node, Side* side)
+{
+    for (;;)
+    {
+        ssize_t n = read(side->sock, side->in + side->inLen, sizeof(side->in) - side->inLen);
+        if (n < 0 && errno == EAGAIN)
+            return;
+        if (n < 0)
+            die("read");
+        if (n == 0)
+        {
+            if (!side->peerDone)
+            {
+                fprintf(stderr, "Philosopher %zu: neighbour hung up on fork #%zu\n", node->name + 1, side->fork);
+                exit(EXIT_FAILURE);
+            }
+            epoll_ctl(node->epoll, EPOLL_CTL_DEL, side->sock, NULL);
+            return;
+        }
+        side->inLen += n;
+
+        size_t offset = 0;
+        while (side->inLen - offset >= sizeof(Message))
+        {
+            Message msg;
+            memcpy(&msg, side->in + offset, sizeof(msg));
+            handle_message(node, side, &msg);
+            offset += sizeof(msg);
+        }
+        memmove(side->in, side->in + offset, side->inLen - offset);
+        side->inLen -= offset;
+    }
+}
+
+void watch(Node* node, int fd, void* ptr)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = ptr };
+    if (epoll_ctl(node->epoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+        die("epoll_ctl");
+}
+
+void run_node(size_t name, int leftSock, int rightSock, Stats* stats)
+{
+    srand(time(NULL) ^ getpid());
+
+    Node node = { .name = name, .state = THINKING, .stats = stats };
+    size_t leftForkIndex = name;
+    size_t rightForkIndex = (name + 1) % num_philosophers;
+    node.sides[LEFT] = (Side){ .sock = leftSock, .fork = leftForkIndex };
+    node.sides[RIGHT] = (Side){ .sock = rightSock, .fork = rightForkIndex };
+
+    // Initially every fork is dirty and held by the lower-numbered of its two
+    // philosophers, the request token by the other one, so the precedence graph is acyclic.
+    for (int i = 0; i < 2; ++i)
+    {
+        Side* side = &node.sides[i];
+        size_t neighbour = i == LEFT ? (name + num_philosophers - 1) % num_philosophers : (name + 1) % num_philosophers;
+        side->haveFork = name < neighbour;
+        side->dirty = true;
+        side->haveToken = !side->haveFork;
+        fcntl(side->sock, F_SETFL, fcntl(side->sock, F_GETFL) | O_NONBLOCK);
+    }
+
+    node.epoll = epoll_create1(0);
+    node.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (node.epoll < 0 || node.timer < 0)
+        die("epoll/timerfd");
+    watch(&node, node.timer, NULL);
+    watch(&node, node.sides[LEFT].sock, &node.sides[LEFT]);
+    watch(&node, node.sides[RIGHT].sock, &node.sides[RIGHT]);
+
+    print("Philosopher %zu is thinking.\n", name + 1);
+    arm_timer(&node);
+
+    while (node.state != FINISHED || !node.sides[LEFT].peerDone || !node.sides[RIGHT].peerDone
+           || node.sides[LEFT].outLen > 0 || node.sides[RIGHT].outLen > 0)
+    {
+        struct epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(node.epoll, events, MAX_EVENTS, -1);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            die("epoll_wait");
+
+        for (int i = 0; i < count; ++i)
+        {
+            Side* side = events[i].data.ptr;
+            if (side == NULL)
+            {
+                uint64_t expirations;
+                if (read(node.timer, &expirations, sizeof(expirations)) < 0)
+                    continue;
+                if (node.state == THINKING)
+                    become_hungry(&node);
+                else if (node.state == EATING)
+                    finish_eating(&node);
+            }
+            else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                receive(&node, side);
+            }
+        }
+
+        flush(&node, &node.sides[LEFT]);
+        flush(&node, &node.sides[RIGHT]);
+    }
+
+    close(node.timer);
+    close(node.epoll);
+    close(leftSock);
+    close(rightSock);
+}
+
+// Creates the connection that carries one fork between its two neighbours.
+void connect_pair(int sv[2])
+{
+    if (!use_tcp)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+            die("socketpair");
+        return;
+    }
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&addr, len) < 0 || listen(listener, 1) < 0)
+        die("listen");
+    getsockname(listener, (struct sockaddr*)&addr, &len);
+
+    sv[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (sv[0] < 0 || connect(sv[0], (struct sockaddr*)&addr, len) < 0)
+        die("connect");
+    sv[1] = accept(listener, NULL, NULL);
+    if (sv[1] < 0)
+        die("accept");
+    close(listener);
+
+    int one = 1;
+    setsockopt(sv[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(sv[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:d:tq")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': num_philosophers = strtoul(optarg, NULL, 10); break;
+        case 'm': meals_limit = strtoul(optarg, NULL, 10); break;
+        case 'd': max_delay_ms = atoi(optarg); break;
+        case 't': use_tcp = true; break;
+        case 'q': quiet = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n philosophers] [-m meals] [-d max_delay_ms] [-t] [-q]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (num_philosophers < 2 || num_philosophers > UINT16_MAX || meals_limit == 0)
+    {
+        fprintf(stderr, "Need at least 2 philosophers and 1 meal.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Only used to collect the results once the nodes have exited.
+    Stats* stats = mmap(NULL, num_philosophers * sizeof(Stats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED)
+        die("mmap");
+    memset(stats, 0, num_philosophers * sizeof(Stats));
+
+    // Fork f is shared by philosopher f (as its left fork) and philosopher f - 1 (as its right fork).
+    int (*pairs)[2] = malloc(num_philosophers * sizeof(*pairs));
+    for (size_t f = 0; f < num_philosophers; ++f)
+        connect_pair(pairs[f]);
+
+    long long start = now_ns();
+    for (size_t i = 0; i < num_philosophers; ++i)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+            die("fork");
+        if (pid == 0)
+        {
+            int leftSock = pairs[i][0];
+            int rightSock = pairs[(i + 1) % num_philosophers][1];
+            for (size_t f = 0; f < num_philosophers; ++f)
+            {
+                if (pairs[f][0] != leftSock)
+                    close(pairs[f][0]);
+                if (pairs[f][1] != rightSock)
+                    close(pairs[f][1]);
+            }
+            run_node(i, leftSock, rightSock, &stats[i]);
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    for (size_t f = 0; f < num_philosophers; ++f)
+    {
+        close(pairs[f][0]);
+        close(pairs[f][1]);
+    }
+    free(pairs);
+
+    int failed = 0;
+    int status;
+    while (wait(&status) > 0)
+    {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            failed++;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    Stats total = {0};
+    for (size_t i = 0; i < num_philosophers; ++i)
+    {
+        Stats* s = &stats[i];
+        printf("Philosopher %zu: %lu meals, %lu messages sent in %lu writes, avg handoff %.1f us, avg hunger %.1f us\n",
+               i + 1, s->meals, s->messagesSent, s->writes,
+               s->handoffs ? s->handoffNs / 1e3 / s->handoffs : 0.0,
+               s->meals ? s->hungryNs / 1e3 / s->meals : 0.0);
+        total.meals += s->meals;
+        total.messagesSent += s->messagesSent;
+        total.writes += s->writes;
+        total.handoffs += s->handoffs;
+        total.handoffNs += s->handoffNs;
+    }
+    printf("%s, %zu processes: %.0f meals/s, %.0f messages/s, %.2f messages per write, avg handoff %.1f us\n",
+           use_tcp ? "loopback TCP" : "Unix sockets", num_philosophers,
+           total.meals / elapsed, total.messagesSent / elapsed,
+           total.writes ? (double)total.messagesSent / total.writes : 0.0,
+           total.handoffs ? total.handoffNs / 1e3 / total.handoffs : 0.0);
+
+    munmap(stats, num_philosophers * sizeof(Stats));
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,516 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdlib.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Chandy-Misra between threads where forks and request tokens are messages.
+// Every philosopher owns a lock-free multi-producer/single-consumer mailbox.
+// The messages are intrusive and preallocated: each fork has exactly one fork
+// message and one request token, and they are passed back and forth between
+// the two neighbours forever, so the steady state never allocates. Sending is
+// an exchange plus a store; a consumer only parks on a futex when its mailbox
+// is empty.
+//
+// Usage: chandy_misra_mailbox [-n philosophers] [-m meals] [-t think_us] [-e eat_us] [-l] [-q]
+//   -l  use a std::mutex + std::condition_variable mailbox instead, for comparison
+//   -q  only print the summary
+
+
+std::ostream&
+print_one(std::ostream& os)
+{
+    return os;
+}
+
+template <class A0, class ...Args>
+std::ostream&
+print_one(std::ostream& os, const A0& a0, const Args& ...args)
+{
+    os << a0;
+    return print_one(os, args...);
+}
+
+template <class ...Args>
+std::ostream&
+print(std::ostream& os, const Args& ...args)
+{
+    return print_one(os, args...);
+}
+
+std::mutex&
+get_cout_mutex()
+{
+    static std::mutex m;
+    return m;
+}
+
+bool quiet = false;
+
+template <class ...Args>
+void
+print(const Args& ...args)
+{
+    if (quiet)
+        return;
+    std::lock_guard<std::mutex> _(get_cout_mutex());
+    print(std::cout, args...);
+}
+
+using Clock = std::chrono::steady_clock;
+
+std::int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+struct Message
+{
+    enum Kind : std::uint8_t { Request, Fork, Done };
+
+    std::atomic<Message*> next{nullptr};
+    Kind kind = Request;
+    std::size_t fork = 0;
+    std::int64_t sentAt = 0;
+};
+
+long futex(std::atomic<std::uint32_t>* addr, int op, std::uint32_t val, const timespec* timeout)
+{
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+    return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), op, val, timeout, nullptr, 0);
+}
+
+// Vyukov's intrusive MPSC queue plus a futex the consumer sleeps on.
+class Mailbox
+{
+public:
+    Mailbox()
+    {
+        head.store(&stub, std::memory_order_relaxed);
+        tail = &stub;
+    }
+
+    void push(Message* msg)
+    {
+        enqueue(msg);
+        // The seq_cst exchange in enqueue() and this load pair with the store
+        // and the head load in park(): either the consumer sees the message or
+        // we see that it is (about to be) asleep.
+        if (sleeping.load(std::memory_order_seq_cst) && sleeping.exchange(0, std::memory_order_relaxed))
+            futex(&sleeping, FUTEX_WAKE_PRIVATE, 1, nullptr);
+    }
+
+    Message* pop()
+    {
+        Message* first = tail;
+        Message* next = first->next.load(std::memory_order_acquire);
+        if (first == &stub)
+        {
+            if (next == nullptr)
+                return nullptr;
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr)
+        {
+            tail = next;
+            return first;
+        }
+        // `first` is the last message; a producer may be half-way through linking a new one.
+        if (first != head.load(std::memory_order_acquire))
+            return nullptr;
+        enqueue(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail = next;
+            return first;
+        }
+        return nullptr;
+    }
+
+    // Sleeps until a message arrives or the timeout (nullptr: none) expires.
+    void park(const timespec* timeout)
+    {
+        sleeping.store(1, std::memory_order_seq_cst);
+        if (!empty())
+        {
+            sleeping.store(0, std::memory_order_relaxed);
+            return;
+        }
+        parks++;
+        futex(&sleeping, FUTEX_WAIT_PRIVATE, 1, timeout);
+        sleeping.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t parks = 0;
+
+private:
+    void enqueue(Message* msg)
+    {
+        msg->next.store(nullptr, std::memory_order_relaxed);
+        Message* prev = head.exchange(msg, std::memory_order_seq_cst);
+        prev->next.store(msg, std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        // A drained queue always ends with the stub re-enqueued as its only node.
+        return tail == &stub && head.load(std::memory_order_seq_cst) == &stub;
+    }
+
+    alignas(64) std::atomic<Message*> head;
+    alignas(64) Message* tail;
+    Message stub;
+    alignas(64) std::atomic<std::uint32_t> sleeping{0};
+};
+
+// The same interface on top of the std::mutex + std::condition_variable pair
+// the other programs use for their forks.
+class LockedMailbox
+{
+public:
+    void push(Message* msg)
+    {
+        std::lock_guard lk(mutex);
+        msg->next.store(nullptr, std::memory_order_relaxed);
+        if (last)
+            last->next.store(msg, std::memory_order_relaxed);
+        else
+            first = msg;
+        last = msg;
+        cv.notify_one();
+    }
+
+    Message* pop()
+    {
+        std::lock_guard lk(mutex);
+        Message* msg = first;
+        if (msg)
+        {
+            first = msg->next.load(std::memory_order_relaxed);
+            if (!first)
+                last = nullptr;
+        }
+        return msg;
+    }
+
+    void park(const timespec* timeout)
+    {
+        std::unique_lock lk(mutex);
+        if (first)
+            return;
+        parks++;
+        if (timeout)
+            cv.wait_for(lk, std::chrono::seconds(timeout->tv_sec) + std::chrono::nanoseconds(timeout->tv_nsec));
+        else
+            cv.wait(lk);
+    }
+
+    std::size_t parks = 0;
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    Message* first = nullptr;
+    Message* last = nullptr;
+};
+
+struct Stats
+{
+    std::size_t meals = 0;
+    std::size_t messagesSent = 0;
+    std::size_t handoffs = 0;
+    std::int64_t handoffNs = 0;
+    std::int64_t hungryNs = 0;
+};
+
+template <class Box>
+class Philosopher
+{
+public:
+    enum State { Thinking, Hungry, Eating, Finished };
+    enum { Left, Right };
+
+    struct Side
+    {
+        std::size_t fork;
+        Philosopher* neighbour = nullptr;
+        Message* forkMsg = nullptr;     // non-null while we hold the fork
+        Message* token = nullptr;       // non-null while we hold the request token
+        Message* done = nullptr;
+        bool dirty = true;
+        bool peerDone = false;
+    };
+
+    std::size_t name;
+    Box mailbox;
+    Side sides[2];
+    Stats stats;
+
+    Philosopher(std::size_t name, std::size_t leftFork, std::size_t rightFork)
+        : name(name)
+    {
+        sides[Left].fork = leftFork;
+        sides[Right].fork = rightFork;
+    }
+
+    void action(std::size_t meals, std::chrono::microseconds thinkTime, std::chrono::microseconds eatTime)
+    {
+        state = Thinking;
+        print("Philosopher ", name, " is thinking.\n\n");
+        deadline = Clock::now() + thinkTime;
+
+        while (state != Finished || !sides[Left].peerDone || !sides[Right].peerDone)
+        {
+            while (Message* msg = mailbox.pop())
+                handle(msg);
+
+            auto now = Clock::now();
+            if (state == Thinking && now >= deadline)
+                becomeHungry();
+            if (state == Hungry && sides[Left].forkMsg && sides[Right].forkMsg)
+            {
+                stats.hungryNs += now_ns() - hungrySince;
+                state = Eating;
+                print("Philosopher ", name, " is dining.\n");
+                deadline = now + eatTime;
+            }
+            if (state == Eating && now >= deadline)
+            {
+                finishEating(meals);
+                if (state == Thinking)
+                {
+                    print("Philosopher ", name, " is thinking.\n\n");
+                    deadline = Clock::now() + thinkTime;
+                }
+                continue;
+            }
+
+            if (state == Thinking || state == Eating)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+                if (left <= 0)
+                    continue;
+                timespec timeout{ static_cast<time_t>(left / 1000000000), static_cast<long>(left % 1000000000) };
+                mailbox.park(&timeout);
+            }
+            else if (state == Hungry || !sides[Left].peerDone || !sides[Right].peerDone)
+            {
+                mailbox.park(nullptr);
+            }
+        }
+    }
+
+private:
+    State state = Thinking;
+    Clock::time_point deadline;
+    std::int64_t hungrySince = 0;
+
+    void send(Side& side, Message* msg)
+    {
+        msg->sentAt = now_ns();
+        stats.messagesSent++;
+        side.neighbour->mailbox.push(msg);
+    }
+
+    void sendFork(Side& side)
+    {
+        Message* msg = side.forkMsg;
+        side.forkMsg = nullptr;
+        side.dirty = false;
+        send(side, msg);
+    }
+
+    void sendRequest(Side& side)
+    {
+        Message* msg = side.token;
+        side.token = nullptr;
+        send(side, msg);
+    }
+
+    Side& sideOf(const Message* msg)
+    {
+        return msg->fork == sides[Left].fork ? sides[Left] : sides[Right];
+    }
+
+    void becomeHungry()
+    {
+        state = Hungry;
+        hungrySince = now_ns();
+        for (auto& side : sides)
+        {
+            if (!side.forkMsg && side.token)
+                sendRequest(side);
+        }
+    }
+
+    void finishEating(std::size_t meals)
+    {
+        stats.meals++;
+        print("Philosopher ", name, " finished dining.\n");
+        // Both forks are dirty now and go to any neighbour that already asked for them.
+        for (auto& side : sides)
+        {
+            side.dirty = true;
+            if (side.token)
+                sendFork(side);
+        }
+
+        if (stats.meals < meals)
+        {
+            state = Thinking;
+            return;
+        }
+        state = Finished;
+        for (auto& side : sides)
+            send(side, side.done);
+    }
+
+    void handle(Message* msg)
+    {
+        Side& side = sideOf(msg);
+        switch (msg->kind)
+        {
+        case Message::Request:
+            side.token = msg;
+            // A dirty fork is handed over unless we are eating with it; a clean one is kept.
+            if (side.forkMsg && side.dirty && state != Eating)
+            {
+                sendFork(side);
+                if (state == Hungry)
+                    sendRequest(side);
+            }
+            break;
+        case Message::Fork:
+            side.forkMsg = msg;
+            side.dirty = false;
+            stats.handoffs++;
+            stats.handoffNs += now_ns() - msg->sentAt;
+            break;
+        case Message::Done:
+            side.peerDone = true;
+            break;
+        }
+    }
+};
+
+template <class Box>
+void run(std::size_t num_philosophers, std::size_t meals, std::chrono::microseconds thinkTime, std::chrono::microseconds eatTime)
+{
+    // Two messages per fork (the fork and its request token) and one "done"
+    // message per philosopher and side: the whole pool, allocated up front.
+    std::unique_ptr<Message[]> forkMsgs(new Message[num_philosophers]);
+    std::unique_ptr<Message[]> tokens(new Message[num_philosophers]);
+    std::unique_ptr<Message[]> dones(new Message[2 * num_philosophers]);
+
+    std::vector<std::unique_ptr<Philosopher<Box>>> philosophers;
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+        philosophers.emplace_back(std::make_unique<Philosopher<Box>>(i + 1, i, (i + 1) % num_philosophers));
+
+    for (std::size_t i = 0; i < num_philosophers; ++i)
+    {
+        auto& p = *philosophers[i];
+        p.sides[0].neighbour = philosophers[(i + num_philosophers - 1) % num_philosophers].get();
+        p.sides[1].neighbour = philosophers[(i + 1) % num_philosophers].get();
+        for (int s = 0; s < 2; ++s)
+        {
+            dones[2 * i + s].kind = Message::Done;
+            dones[2 * i + s].fork = p.sides[s].fork;
+            p.sides[s].done = &dones[2 * i + s];
+        }
+    }
+
+    // Fork f is shared by philosopher f (left) and f - 1 (right). It starts
+    // dirty with the lower-numbered of the two, the request token with the other.
+    for (std::size_t f = 0; f < num_philosophers; ++f)
+    {
+        forkMsgs[f].kind = Message::Fork;
+        forkMsgs[f].fork = f;
+        tokens[f].kind = Message::Request;
+        tokens[f].fork = f;
+
+        auto& leftUser = philosophers[f]->sides[0];
+        auto& rightUser = philosophers[(f + num_philosophers - 1) % num_philosophers]->sides[1];
+        bool leftUserIsLower = f < (f + num_philosophers - 1) % num_philosophers;
+        (leftUserIsLower ? leftUser : rightUser).forkMsg = &forkMsgs[f];
+        (leftUserIsLower ? rightUser : leftUser).token = &tokens[f];
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (auto& philosopher : philosophers)
+        threads.emplace_back(&Philosopher<Box>::action, philosopher.get(), meals, thinkTime, eatTime);
+
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    Stats total;
+    std::size_t parks = 0;
+    for (auto& p : philosophers)
+    {
+        total.meals += p->stats.meals;
+        total.messagesSent += p->stats.messagesSent;
+        total.handoffs += p->stats.handoffs;
+        total.handoffNs += p->stats.handoffNs;
+        total.hungryNs += p->stats.hungryNs;
+        parks += p->mailbox.parks;
+    }
+    std::cout << (std::is_same_v<Box, Mailbox> ? "Lock-free mailbox" : "Mutex mailbox") << ", "
+              << num_philosophers << " philosophers: "
+              << std::size_t(total.meals / elapsed.count()) << " meals/s, "
+              << std::size_t(total.messagesSent / elapsed.count()) << " messages/s, "
+              << "avg handoff " << (total.handoffs ? total.handoffNs / total.handoffs : 0) << " ns, "
+              << "avg hunger " << (total.meals ? total.hungryNs / total.meals : 0) << " ns, "
+              << (total.meals ? double(parks) / total.meals : 0.0) << " parks per meal\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t num_philosophers = 5;
+    std::size_t meals = 100000;
+    std::chrono::microseconds thinkTime(0);
+    std::chrono::microseconds eatTime(0);
+    bool locked = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:t:e:lq")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': num_philosophers = std::stoul(optarg); break;
+        case 'm': meals = std::stoul(optarg); break;
+        case 't': thinkTime = std::chrono::microseconds(std::stol(optarg)); break;
+        case 'e': eatTime = std::chrono::microseconds(std::stol(optarg)); break;
+        case 'l': locked = true; break;
+        case 'q': quiet = true; break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-n philosophers] [-m meals] [-t think_us] [-e eat_us] [-l] [-q]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (num_philosophers < 2 || meals == 0)
+    {
+        std::cerr << "Need at least 2 philosophers and 1 meal.\n";
+        return EXIT_FAILURE;
+    }
+
+    if (locked)
+        run<LockedMailbox>(num_philosophers, meals, thinkTime, eatTime);
+    else
+        run<Mailbox>(num_philosophers, meals, thinkTime, eatTime);
+}
@@ -5,36 +5,80 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #define NUM_PHILOSOPHERS 5
 
-pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-void print(const char* format, ...)
-{
-    va_list args;
-    pthread_mutex_lock(&print_mutex);
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
-    pthread_mutex_unlock(&print_mutex);
-}
+// Usage: chandy_misra_method [-p] [-m meals] [-d max_delay_ms] [-c crash_permille]
+//   -p  run every philosopher as a separate process instead of a thread
+//   -m  meals per philosopher before exiting (0 = dine forever)
+//   -d  upper bound for the random thinking/dining time
+//   -c  (with -p) chance per meal that a philosopher dies while holding both forks
 
 typedef struct
 {
     pthread_mutex_t mutex;
     pthread_cond_t cv;
     bool isTaken;
+    long long abandonedAt; // set by a philosopher that dies holding the fork, 0 otherwise
 } Fork;
 
+typedef struct
+{
+    unsigned long meals;
+    unsigned long long waitNs;
+    unsigned long recoveries;
+    unsigned long long recoveryNs;
+} Stats;
+
+// Everything the philosophers share. It lives in an mmap'd segment so that
+// forked philosopher processes see the same forks as the parent.
+typedef struct
+{
+    pthread_mutex_t print_mutex;
+    Fork forks[NUM_PHILOSOPHERS];
+    Stats stats[NUM_PHILOSOPHERS];
+} Table;
+
 typedef struct
 {
     size_t name;
     size_t num_philosophers;
     Fork* leftFork;
     Fork* rightFork;
+    Stats* stats;
 } Philosopher;
 
+Table* table;
+unsigned long meals_limit = 0;
+int max_delay_ms = 3000;
+int crash_permille = 0;
+bool use_processes = false;
+
+long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void print(const char* format, ...)
+{
+    va_list args;
+    // A philosopher process may die while printing; nothing to repair then.
+    if (pthread_mutex_lock(&table->print_mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&table->print_mutex);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    fflush(stdout);
+    pthread_mutex_unlock(&table->print_mutex);
+}
+
 void takeFork(Fork* fork)
 {
     fork->isTaken = true;
@@ -47,13 +91,45 @@ void putFork(Fork* fork)
     pthread_cond_signal(&fork->cv);
 }
 
+// The previous owner died while holding the fork: put it back on the table.
+// Recovery latency runs from the death, or from when this philosopher started
+// waiting if that was later, so a neighbour's thinking time is not counted.
+void recoverFork(Fork* fork, Stats* stats, long long waitStart)
+{
+    if (fork->abandonedAt != 0)
+    {
+        long long from = fork->abandonedAt > waitStart ? fork->abandonedAt : waitStart;
+        stats->recoveryNs += now_ns() - from;
+        fork->abandonedAt = 0;
+    }
+    stats->recoveries++;
+    putFork(fork);
+    pthread_mutex_consistent(&fork->mutex);
+}
+
+void lockFork(Fork* fork, Stats* stats)
+{
+    long long start = now_ns();
+    int rc = pthread_mutex_lock(&fork->mutex);
+    if (rc == EOWNERDEAD)
+        recoverFork(fork, stats, start);
+
+    while (fork->isTaken)
+    {
+        rc = pthread_cond_wait(&fork->cv, &fork->mutex);
+        if (rc == EOWNERDEAD)
+            recoverFork(fork, stats, start);
+    }
+    stats->waitNs += now_ns() - start;
+}
+
 void* philosopher_action(void* arg)
 {
     Philosopher* philosopher = (Philosopher*)arg;
-    while (1)
+    while (meals_limit == 0 || philosopher->stats->meals < meals_limit)
     {
         print("Philosopher %zu is thinking.\n", philosopher->name);
-        int r = rand() % 3000;
+        int r = rand() % (max_delay_ms + 1);
         usleep(r * 1000);
 
         size_t leftForkIndex = philosopher->name - 1;
@@ -65,23 +141,28 @@ void* philosopher_action(void* arg)
         Fork* firstFork = (firstForkIndex == leftForkIndex) ? philosopher->leftFork : philosopher->rightFork;
         Fork* secondFork = (secondForkIndex == rightForkIndex) ? philosopher->rightFork : philosopher->leftFork;
 
-        pthread_mutex_lock(&firstFork->mutex);
-        while (firstFork->isTaken)
-            pthread_cond_wait(&firstFork->cv, &firstFork->mutex);
-
+        lockFork(firstFork, philosopher->stats);
         takeFork(firstFork);
 
-        pthread_mutex_lock(&secondFork->mutex);
-        while (secondFork->isTaken)
-            pthread_cond_wait(&secondFork->cv, &secondFork->mutex);
-
+        lockFork(secondFork, philosopher->stats);
         takeFork(secondFork);
 
         // Dining
         print("Philosopher %zu is dining. So he took fork #%zu and #%zu\n", philosopher->name, firstForkIndex, secondForkIndex);
-        r = rand() % 3000;
+        r = rand() % (max_delay_ms + 1);
         usleep(r * 1000);
 
+        if (use_processes && rand() % 1000 < crash_permille)
+        {
+            print("Philosopher %zu dies holding fork #%zu and #%zu.\n", philosopher->name, firstForkIndex, secondForkIndex);
+            long long diedAt = now_ns();
+            firstFork->abandonedAt = diedAt;
+            secondFork->abandonedAt = diedAt;
+            _exit(EXIT_FAILURE);
+        }
+
+        philosopher->stats->meals++;
+
         putFork(firstFork);
         pthread_mutex_unlock(&firstFork->mutex);
         pthread_cond_signal(&firstFork->cv);
@@ -96,38 +177,150 @@ void* philosopher_action(void* arg)
     return NULL;
 }
 
-int main()
+pid_t spawn_philosopher(Philosopher* philosopher)
 {
-    srand(time(NULL));
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        srand(time(NULL) ^ getpid());
+        philosopher_action(philosopher);
+        _exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
 
-    Fork forks[NUM_PHILOSOPHERS];
-    Philosopher philosophers[NUM_PHILOSOPHERS];
-    pthread_t threads[NUM_PHILOSOPHERS];
+void init_table(bool shared)
+{
+    table = mmap(NULL, sizeof(Table), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    memset(table, 0, sizeof(Table));
+
+    int pshared = shared ? PTHREAD_PROCESS_SHARED : PTHREAD_PROCESS_PRIVATE;
+    pthread_mutexattr_t mutex_attr;
+    pthread_condattr_t cond_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, pshared);
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, pshared);
 
+    pthread_mutex_init(&table->print_mutex, &mutex_attr);
     for (int i = 0; i < NUM_PHILOSOPHERS; ++i)
     {
-        forks[i].isTaken = false;
-        pthread_mutex_init(&forks[i].mutex, NULL);
-        pthread_cond_init(&forks[i].cv, NULL);
+        table->forks[i].isTaken = false;
+        pthread_mutex_init(&table->forks[i].mutex, &mutex_attr);
+        pthread_cond_init(&table->forks[i].cv, &cond_attr);
     }
 
+    pthread_mutexattr_destroy(&mutex_attr);
+    pthread_condattr_destroy(&cond_attr);
+}
+
+void destroy_table(void)
+{
     for (int i = 0; i < NUM_PHILOSOPHERS; ++i)
     {
-        philosophers[i].name = i + 1;
-        philosophers[i].leftFork = &forks[i];
-        philosophers[i].rightFork = &forks[(i + 1) % NUM_PHILOSOPHERS];
-        philosophers[i].num_philosophers = NUM_PHILOSOPHERS;
-        pthread_create(&threads[i], NULL, philosopher_action, &philosophers[i]);
+        pthread_mutex_destroy(&table->forks[i].mutex);
+        pthread_cond_destroy(&table->forks[i].cv);
     }
+    pthread_mutex_destroy(&table->print_mutex);
+    munmap(table, sizeof(Table));
+}
 
+void print_stats(void)
+{
     for (int i = 0; i < NUM_PHILOSOPHERS; ++i)
-        pthread_join(threads[i], NULL);
+    {
+        Stats* stats = &table->stats[i];
+        printf("Philosopher %d: %lu meals, avg fork wait %.1f us, %lu recoveries",
+               i + 1, stats->meals, stats->meals ? stats->waitNs / 1e3 / stats->meals : 0.0, stats->recoveries);
+        if (stats->recoveries)
+            printf(", avg recovery latency %.1f us", stats->recoveryNs / 1e3 / stats->recoveries);
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "pm:d:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': use_processes = true; break;
+        case 'm': meals_limit = strtoul(optarg, NULL, 10); break;
+        case 'd': max_delay_ms = atoi(optarg); break;
+        case 'c': crash_permille = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-p] [-m meals] [-d max_delay_ms] [-c crash_permille]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_delay_ms < 0 || crash_permille < 0 || crash_permille > 1000)
+    {
+        fprintf(stderr, "Need a delay of at least 0 ms and a crash chance between 0 and 1000 permille.\n");
+        return EXIT_FAILURE;
+    }
+    if (crash_permille > 0 && !use_processes)
+    {
+        fprintf(stderr, "Crashes (-c) need one process per philosopher (-p).\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(time(NULL));
+    init_table(use_processes);
+
+    Philosopher philosophers[NUM_PHILOSOPHERS];
+    pthread_t threads[NUM_PHILOSOPHERS];
+    pid_t pids[NUM_PHILOSOPHERS];
 
     for (int i = 0; i < NUM_PHILOSOPHERS; ++i)
     {
-        pthread_mutex_destroy(&forks[i].mutex);
-        pthread_cond_destroy(&forks[i].cv);
+        philosophers[i].name = i + 1;
+        philosophers[i].leftFork = &table->forks[i];
+        philosophers[i].rightFork = &table->forks[(i + 1) % NUM_PHILOSOPHERS];
+        philosophers[i].num_philosophers = NUM_PHILOSOPHERS;
+        philosophers[i].stats = &table->stats[i];
+        if (use_processes)
+            pids[i] = spawn_philosopher(&philosophers[i]);
+        else
+            pthread_create(&threads[i], NULL, philosopher_action, &philosophers[i]);
+    }
+
+    if (use_processes)
+    {
+        // Respawn philosophers that died mid-meal; their forks are recovered
+        // by whichever neighbour locks them next.
+        int running = NUM_PHILOSOPHERS;
+        while (running > 0)
+        {
+            int status;
+            pid_t pid = wait(&status);
+            if (pid < 0)
+                break;
+            for (int i = 0; i < NUM_PHILOSOPHERS; ++i)
+            {
+                if (pids[i] != pid)
+                    continue;
+                if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+                    running--;
+                else
+                    pids[i] = spawn_philosopher(&philosophers[i]);
+            }
+        }
     }
+    else
+    {
+        for (int i = 0; i < NUM_PHILOSOPHERS; ++i)
+            pthread_join(threads[i], NULL);
+    }
+
+    print_stats();
+    destroy_table();
 
     return 0;
 }
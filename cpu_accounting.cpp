@@ -0,0 +1,492 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdlib.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+// How much CPU each strategy burns while it waits for forks. Every philosopher
+// thread records its own CPU time (CLOCK_THREAD_CPUTIME_ID), its voluntary
+// and involuntary context switches (getrusage(RUSAGE_THREAD)) and wakeups that
+// found the forks still taken. The waiting styles are taken from the other
+// programs:
+//   cv wait        block in cv.wait until the fork is put down (datarace.cpp, chandy_misra_method.cpp)
+//   wait_for       cv.wait_for with a timeout, back to thinking on failure (deadlock.cpp)
+//   usleep poll    request_forks in a usleep(100) loop (waiter_method.c)
+//   waiter         takeIfForkAvailable, back to thinking on failure (waiter_method.cpp)
+// A philosopher waits from its first attempt until it holds both forks. The
+// back-off after a failed attempt runs the thinking kernel and is left out of
+// the wait, both its CPU and its wall time. The idle-wait efficiency is the
+// share of the remaining wall time not spent on a CPU: 1.0 means the
+// philosopher slept through all of its attempts.
+//
+// Thinking and eating either sleep, like the other programs, or run a kernel
+// that competes for the CPU or memory, given as kernel:units:
+//   sleep      1 unit = 1 ms asleep
+//   compute    1 unit = 1000 rounds of a dependent integer hash
+//   cache      1 unit = one read-modify-write pass over a 32 KiB per-thread working set
+//   stream     1 unit = 1 MiB read from a 64 MiB per-thread buffer
+// Units finished while eating, thinking and backing off are reported per second.
+//
+// Usage: cpu_accounting [-d seconds_per_strategy] [-t [kernel:]think_units] [-e [kernel:]eat_units]
+
+
+using Clock = std::chrono::steady_clock;
+
+enum class Kernel { Sleep, Compute, Cache, Stream };
+
+const char* kernel_names[] = { "sleep", "compute", "cache", "stream" };
+
+struct Work
+{
+    Kernel kernel = Kernel::Sleep;
+    std::size_t units = 10;
+};
+
+constexpr std::size_t cache_words = (32 << 10) / sizeof(std::uint64_t);
+constexpr std::size_t stream_words = (64 << 20) / sizeof(std::uint64_t);
+constexpr std::size_t stream_unit_words = (1 << 20) / sizeof(std::uint64_t);
+
+// Per-thread buffers for the kernels, only allocated when a kernel needs them.
+struct Scratch
+{
+    std::vector<std::uint64_t> cache;
+    std::vector<std::uint64_t> stream;
+    std::size_t streamPos = 0;
+    std::uint64_t sink = 1;
+
+    Scratch(const Work& think, const Work& eat)
+    {
+        if (think.kernel == Kernel::Cache || eat.kernel == Kernel::Cache)
+            cache.assign(cache_words, 1);
+        if (think.kernel == Kernel::Stream || eat.kernel == Kernel::Stream)
+            stream.assign(stream_words, 1);
+    }
+};
+
+void do_work(const Work& work, Scratch& scratch)
+{
+    switch (work.kernel)
+    {
+    case Kernel::Sleep:
+        std::this_thread::sleep_for(std::chrono::milliseconds(work.units));
+        break;
+    case Kernel::Compute:
+    {
+        std::uint64_t x = scratch.sink | 1;
+        for (std::size_t i = 0; i < work.units * 1000; ++i)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+        scratch.sink += x;
+        break;
+    }
+    case Kernel::Cache:
+        for (std::size_t unit = 0; unit < work.units; ++unit)
+        {
+            for (auto& v : scratch.cache)
+            {
+                v = v * 3 + scratch.sink;
+                scratch.sink ^= v;
+            }
+        }
+        break;
+    case Kernel::Stream:
+        for (std::size_t unit = 0; unit < work.units; ++unit)
+        {
+            std::uint64_t sum = 0;
+            const std::uint64_t* chunk = &scratch.stream[scratch.streamPos];
+            for (std::size_t i = 0; i < stream_unit_words; ++i)
+                sum += chunk[i];
+            scratch.sink += sum;
+            scratch.streamPos = (scratch.streamPos + stream_unit_words) % stream_words;
+        }
+        break;
+    }
+}
+
+bool parse_work(const std::string& arg, Work& work)
+{
+    std::size_t colon = arg.find(':');
+    std::string kernel = colon == std::string::npos ? "sleep" : arg.substr(0, colon);
+    std::string units = colon == std::string::npos ? arg : arg.substr(colon + 1);
+    for (std::size_t k = 0; k < std::size(kernel_names); ++k)
+    {
+        if (kernel == kernel_names[k])
+        {
+            work.kernel = static_cast<Kernel>(k);
+            work.units = std::stoul(units);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::int64_t thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Fork
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool isTaken = false;
+
+    void takeFork()
+    {
+        isTaken = true;
+        cv.notify_one();
+    }
+
+    void putFork()
+    {
+        isTaken = false;
+        cv.notify_one();
+    }
+};
+
+struct Account
+{
+    std::uint64_t meals = 0;
+    std::uint64_t eatUnits = 0;
+    std::uint64_t thinkUnits = 0;
+    std::uint64_t backoffUnits = 0;
+    std::uint64_t spurious = 0;
+    std::int64_t cpuNs = 0;
+    std::int64_t waitCpuNs = 0;
+    std::int64_t waitWallNs = 0;
+    long voluntary = 0;
+    long involuntary = 0;
+
+    Account& operator+=(const Account& o)
+    {
+        meals += o.meals;
+        eatUnits += o.eatUnits;
+        thinkUnits += o.thinkUnits;
+        backoffUnits += o.backoffUnits;
+        spurious += o.spurious;
+        cpuNs += o.cpuNs;
+        waitCpuNs += o.waitCpuNs;
+        waitWallNs += o.waitWallNs;
+        voluntary += o.voluntary;
+        involuntary += o.involuntary;
+        return *this;
+    }
+};
+
+struct Table
+{
+    std::vector<Fork> forks;
+    pthread_mutex_t waiter_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<int> forks_taken;
+
+    explicit Table(std::size_t seats) : forks(seats), forks_taken(seats, 0) {}
+    ~Table() { pthread_mutex_destroy(&waiter_mutex); }
+
+    std::size_t left(std::size_t seat) const { return seat; }
+    std::size_t right(std::size_t seat) const { return (seat + 1) % forks.size(); }
+
+    std::size_t howMuchTaken()
+    {
+        std::size_t counter = 0;
+        for (auto& i : forks)
+        {
+            if (i.isTaken)
+                counter++;
+        }
+        return counter;
+    }
+};
+
+void put_down(Fork& fork)
+{
+    std::lock_guard<std::mutex> lk(fork.mutex);
+    fork.putFork();
+}
+
+void cv_take(Fork& fork, Account& account)
+{
+    std::unique_lock<std::mutex> lk(fork.mutex);
+    while (fork.isTaken)
+    {
+        fork.cv.wait(lk);
+        if (fork.isTaken)
+            account.spurious++;
+    }
+    fork.takeFork();
+}
+
+bool cv_wait(Table& table, std::size_t seat, Account& account)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    cv_take(table.forks[std::min(leftForkIndex, rightForkIndex)], account);
+    cv_take(table.forks[std::max(leftForkIndex, rightForkIndex)], account);
+    return true;
+}
+
+bool timed_take(Fork& fork, Account& account)
+{
+    std::unique_lock<std::mutex> lk(fork.mutex);
+    auto deadline = Clock::now() + std::chrono::milliseconds(1000);
+    while (fork.isTaken)
+    {
+        if (fork.cv.wait_until(lk, deadline) == std::cv_status::timeout)
+            break;
+        if (fork.isTaken)
+            account.spurious++;
+    }
+    if (fork.isTaken)
+        return false;
+    fork.takeFork();
+    return true;
+}
+
+bool cv_wait_for(Table& table, std::size_t seat, Account& account)
+{
+    Fork& leftFork = table.forks[table.left(seat)];
+    Fork& rightFork = table.forks[table.right(seat)];
+    if (!timed_take(leftFork, account))
+        return false;
+    if (!timed_take(rightFork, account))
+    {
+        put_down(leftFork);
+        return false;
+    }
+    return true;
+}
+
+bool usleep_poll(Table& table, std::size_t seat, Account& account)
+{
+    int leftForkIndex = table.left(seat);
+    int rightForkIndex = table.right(seat);
+    while (true)
+    {
+        pthread_mutex_lock(&table.waiter_mutex);
+        if (table.forks_taken[leftForkIndex] == 0 && table.forks_taken[rightForkIndex] == 0)
+        {
+            table.forks_taken[leftForkIndex] = 1;
+            table.forks_taken[rightForkIndex] = 1;
+            pthread_mutex_unlock(&table.waiter_mutex);
+            return true;
+        }
+        pthread_mutex_unlock(&table.waiter_mutex);
+        usleep(100);
+        account.spurious++;
+    }
+}
+
+bool waiter_try(Table& table, std::size_t seat, Account& account)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    // Same checks as Waiter::takeIfForkAvailable, failed attempts count as wasted wakeups.
+    if (table.howMuchTaken() == table.forks.size() - 1)
+    {
+        account.spurious++;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lk(table.forks[leftForkIndex].mutex);
+        if (table.forks[leftForkIndex].isTaken)
+        {
+            account.spurious++;
+            return false;
+        }
+        table.forks[leftForkIndex].takeFork();
+    }
+    {
+        std::lock_guard<std::mutex> lk(table.forks[rightForkIndex].mutex);
+        if (!table.forks[rightForkIndex].isTaken)
+        {
+            table.forks[rightForkIndex].takeFork();
+            return true;
+        }
+    }
+    put_down(table.forks[leftForkIndex]);
+    account.spurious++;
+    return false;
+}
+
+void put_forks(Table& table, std::size_t seat, bool polled)
+{
+    if (polled)
+    {
+        pthread_mutex_lock(&table.waiter_mutex);
+        table.forks_taken[table.left(seat)] = 0;
+        table.forks_taken[table.right(seat)] = 0;
+        pthread_mutex_unlock(&table.waiter_mutex);
+        return;
+    }
+    put_down(table.forks[table.left(seat)]);
+    put_down(table.forks[table.right(seat)]);
+}
+
+struct Strategy
+{
+    const char* name;
+    bool (*takeForks)(Table&, std::size_t, Account&);
+    bool polled;    // forks live in forks_taken rather than in Fork::isTaken
+};
+
+const Strategy strategies[] = {
+    { "cv wait", cv_wait, false },
+    { "wait_for", cv_wait_for, false },
+    { "usleep poll", usleep_poll, true },
+    { "waiter", waiter_try, false },
+};
+
+std::atomic<std::uint64_t> checksum{0};
+
+Account run(const Strategy& strategy, std::size_t num_philosophers, std::chrono::seconds duration,
+            const Work& think, const Work& eat)
+{
+    Table table(num_philosophers);
+    std::atomic<bool> stop{false};
+    std::vector<Account> accounts(num_philosophers);
+
+    std::vector<std::thread> threads;
+    for (std::size_t seat = 0; seat < num_philosophers; ++seat)
+    {
+        threads.emplace_back([&, seat]
+        {
+            Account account;
+            Scratch scratch(think, eat);
+            std::int64_t cpuStart = thread_cpu_ns();
+            rusage before;
+            getrusage(RUSAGE_THREAD, &before);
+
+            bool hungry = false;
+            std::int64_t hungryCpu = 0;
+            Clock::time_point hungryWall;
+
+            while (!stop)
+            {
+                // After a failed attempt this is the back-off, and the philosopher stays hungry.
+                if (hungry)
+                {
+                    // Shifting the start of the wait leaves the back-off out of it.
+                    std::int64_t backoffCpu = thread_cpu_ns();
+                    auto backoffWall = Clock::now();
+                    do_work(think, scratch);
+                    hungryCpu += thread_cpu_ns() - backoffCpu;
+                    hungryWall += Clock::now() - backoffWall;
+                    account.backoffUnits += think.units;
+                }
+                else
+                {
+                    do_work(think, scratch);
+                    account.thinkUnits += think.units;
+                    hungry = true;
+                    hungryCpu = thread_cpu_ns();
+                    hungryWall = Clock::now();
+                }
+
+                if (!strategy.takeForks(table, seat, account))
+                    continue;
+                hungry = false;
+                account.waitCpuNs += thread_cpu_ns() - hungryCpu;
+                account.waitWallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - hungryWall).count();
+
+                do_work(eat, scratch);
+                put_forks(table, seat, strategy.polled);
+                account.meals++;
+                account.eatUnits += eat.units;
+            }
+
+            // A philosopher still hungry at the end has been waiting too, possibly for the whole run.
+            if (hungry)
+            {
+                account.waitCpuNs += thread_cpu_ns() - hungryCpu;
+                account.waitWallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - hungryWall).count();
+            }
+
+            rusage after;
+            getrusage(RUSAGE_THREAD, &after);
+            account.cpuNs = thread_cpu_ns() - cpuStart;
+            account.voluntary = after.ru_nvcsw - before.ru_nvcsw;
+            account.involuntary = after.ru_nivcsw - before.ru_nivcsw;
+            accounts[seat] = account;
+            checksum += scratch.sink;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+
+    Account total;
+    for (auto& account : accounts)
+        total += account;
+    return total;
+}
+
+int main(int argc, char* argv[])
+{
+    std::chrono::seconds duration(5);
+    Work think;
+    Work eat;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:e:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd': duration = std::chrono::seconds(std::stol(optarg)); break;
+        case 't':
+        case 'e':
+            if (parse_work(optarg, opt == 't' ? think : eat))
+                break;
+            [[fallthrough]];
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-d seconds_per_strategy] [-t [kernel:]think_units] [-e [kernel:]eat_units]\n"
+                      << "kernels: sleep, compute, cache, stream\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::size_t num_philosophers = 5;
+    std::cout << "think: " << kernel_names[static_cast<int>(think.kernel)] << " x " << think.units
+              << ", eat: " << kernel_names[static_cast<int>(eat.kernel)] << " x " << eat.units << "\n";
+    std::cout << std::left << std::setw(14) << "strategy" << std::right
+              << std::setw(8) << "meals" << std::setw(14) << "cpu us/meal" << std::setw(15) << "wait cpu us"
+              << std::setw(12) << "vcsw/meal" << std::setw(12) << "ivcsw/meal" << std::setw(16) << "spurious/meal"
+              << std::setw(12) << "idle ratio" << std::setw(14) << "eat units/s" << std::setw(16) << "think units/s"
+              << std::setw(18) << "backoff units/s" << "\n";
+
+    for (const auto& strategy : strategies)
+    {
+        Account a = run(strategy, num_philosophers, duration, think, eat);
+        double meals = std::max<std::uint64_t>(1, a.meals);
+        std::cout << std::left << std::setw(14) << strategy.name << std::right << std::fixed
+                  << std::setw(8) << a.meals
+                  << std::setprecision(1) << std::setw(14) << a.cpuNs / 1e3 / meals
+                  << std::setw(15) << a.waitCpuNs / 1e3 / meals
+                  << std::setprecision(2) << std::setw(12) << a.voluntary / meals
+                  << std::setw(12) << a.involuntary / meals
+                  << std::setw(16) << a.spurious / meals
+                  << std::setprecision(3) << std::setw(12) << (a.waitWallNs ? std::max(0.0, 1.0 - double(a.waitCpuNs) / a.waitWallNs) : 1.0)
+                  << std::setprecision(1) << std::setw(14) << a.eatUnits / double(duration.count())
+                  << std::setw(16) << a.thinkUnits / double(duration.count())
+                  << std::setw(18) << a.backoffUnits / double(duration.count())
+                  << "\n";
+    }
+}
@@ -0,0 +1,424 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdlib.h>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Microbenchmarks for the fork acquire/release paths of the other programs,
+// without their thinking and dining sleeps. The primitives are copied from
+// their files and have to be kept in sync with them:
+//   fork wait        Fork::takeFork/putFork behind cv.wait (chandy_misra_method.cpp, datarace.cpp)
+//   fork wait_for    the timed cv.wait_for path (deadlock.cpp)
+//   waiter           Waiter::takeIfForkAvailable/putFork (waiter_method.cpp)
+//   request_forks    request_forks/release_forks (waiter_method.c)
+// One operation is one philosopher trying to take both forks and, if that
+// succeeded, putting them back. Both Fork variants take the lower-numbered
+// fork first; deadlock.cpp's left-then-right order can deadlock a ring that
+// never sleeps.
+//
+// Scenarios: one philosopher alone, two neighbours sharing a fork, and N
+// philosophers around an N-seat table for N up to the core count. A ping-pong
+// test passes one fork back and forth between two cores.
+//
+// Usage: microbench [-t ms_per_run] [-n max_threads]
+
+
+using Clock = std::chrono::steady_clock;
+
+struct Fork
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool isTaken = false;
+
+    void takeFork()
+    {
+        isTaken = true;
+        cv.notify_one();
+    }
+
+    void putFork()
+    {
+        isTaken = false;
+        cv.notify_one();
+    }
+};
+
+struct Waiter
+{
+    Waiter (std::vector<Fork>& forks_) : forks(forks_) {}
+    bool takeIfForkAvailable(size_t idl, size_t idr, bool second_fork = false)
+    {
+        (void)idr;
+        if (howMuchTaken() == forks.size() - 1 and !second_fork)
+            return false;
+        std::lock_guard lk(forks[idl].mutex);
+        if (!forks[idl].isTaken)
+        {
+            forks[idl].takeFork();
+            return true;
+        }
+        return false;
+    }
+
+    void putFork(size_t id)
+    {
+        std::lock_guard lk(forks[id].mutex);
+        forks[id].putFork();
+    }
+
+private:
+    std::vector<Fork>& forks;
+
+    size_t howMuchTaken()
+    {
+        size_t counter = 0;
+        for (auto& i : forks)
+        {
+            if (i.isTaken)
+                counter++;
+        }
+        return counter;
+    }
+};
+
+struct Table
+{
+    std::size_t seats;
+    std::vector<Fork> forks;
+    Waiter waiter;
+    pthread_mutex_t waiter_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<int> forks_taken;
+
+    explicit Table(std::size_t seats) : seats(seats), forks(seats), waiter(forks), forks_taken(seats, 0) {}
+    ~Table() { pthread_mutex_destroy(&waiter_mutex); }
+
+    std::size_t left(std::size_t seat) const { return seat; }
+    std::size_t right(std::size_t seat) const { return (seat + 1) % seats; }
+};
+
+bool fork_wait(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    Fork& firstForkRef = table.forks[std::min(leftForkIndex, rightForkIndex)];
+    Fork& secondForkRef = table.forks[std::max(leftForkIndex, rightForkIndex)];
+
+    std::unique_lock<std::mutex> lockFirstFork(firstForkRef.mutex);
+    while (firstForkRef.isTaken)
+        firstForkRef.cv.wait(lockFirstFork);
+    firstForkRef.takeFork();
+
+    std::unique_lock<std::mutex> lockSecondFork(secondForkRef.mutex);
+    while (secondForkRef.isTaken)
+        secondForkRef.cv.wait(lockSecondFork);
+    secondForkRef.takeFork();
+
+    firstForkRef.putFork();
+    lockFirstFork.unlock();
+    firstForkRef.cv.notify_one();
+
+    secondForkRef.putFork();
+    lockSecondFork.unlock();
+    secondForkRef.cv.notify_one();
+    return true;
+}
+
+bool fork_wait_for(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    Fork& firstFork = table.forks[std::min(leftForkIndex, rightForkIndex)];
+    Fork& secondFork = table.forks[std::max(leftForkIndex, rightForkIndex)];
+
+    std::unique_lock<std::mutex> lf(firstFork.mutex);
+    if (!firstFork.cv.wait_for(lf, std::chrono::milliseconds(1000), [&] { return !firstFork.isTaken; }))
+        return false;
+    firstFork.takeFork();
+
+    std::unique_lock<std::mutex> rf(secondFork.mutex);
+    if (!secondFork.cv.wait_for(rf, std::chrono::milliseconds(1000), [&] { return !secondFork.isTaken; }))
+    {
+        firstFork.putFork();
+        lf.unlock();
+        firstFork.cv.notify_one();
+        return false;
+    }
+    secondFork.takeFork();
+
+    secondFork.putFork();
+    firstFork.putFork();
+    rf.unlock();
+    lf.unlock();
+    secondFork.cv.notify_one();
+    firstFork.cv.notify_one();
+    return true;
+}
+
+bool waiter_take(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+
+    if (!table.waiter.takeIfForkAvailable(leftForkIndex, rightForkIndex))
+        return false;
+    if (!table.waiter.takeIfForkAvailable(rightForkIndex, leftForkIndex, true))
+    {
+        table.waiter.putFork(leftForkIndex);
+        return false;
+    }
+    table.waiter.putFork(leftForkIndex);
+    table.waiter.putFork(rightForkIndex);
+    return true;
+}
+
+bool request_release(Table& table, std::size_t seat)
+{
+    int leftForkIndex = table.left(seat);
+    int rightForkIndex = table.right(seat);
+
+    pthread_mutex_lock(&table.waiter_mutex);
+    if (table.forks_taken[leftForkIndex] != 0 || table.forks_taken[rightForkIndex] != 0)
+    {
+        pthread_mutex_unlock(&table.waiter_mutex);
+        return false;
+    }
+    table.forks_taken[leftForkIndex] = 1;
+    table.forks_taken[rightForkIndex] = 1;
+    pthread_mutex_unlock(&table.waiter_mutex);
+
+    pthread_mutex_lock(&table.waiter_mutex);
+    table.forks_taken[leftForkIndex] = 0;
+    table.forks_taken[rightForkIndex] = 0;
+    pthread_mutex_unlock(&table.waiter_mutex);
+    return true;
+}
+
+struct Primitive
+{
+    const char* name;
+    bool (*op)(Table&, std::size_t);
+};
+
+const Primitive primitives[] = {
+    { "fork wait", fork_wait },
+    { "fork wait_for", fork_wait_for },
+    { "waiter", waiter_take },
+    { "request_forks", request_release },
+};
+
+std::vector<int> usable_cpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+void pin(std::thread& thread, const std::vector<int>& cpus, std::size_t index)
+{
+    if (cpus.empty())
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[index % cpus.size()], &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+}
+
+struct alignas(64) Counter
+{
+    std::uint64_t ops = 0;
+    std::uint64_t succeeded = 0;
+};
+
+// Runs `op` from one thread per seat in `seats_used` and returns the average
+// time one thread needs per operation, plus the share that got both forks.
+std::pair<double, double> measure(const Primitive& primitive, std::size_t seats, const std::vector<std::size_t>& seats_used,
+                                  std::chrono::milliseconds duration, const std::vector<int>& cpus)
+{
+    Table table(seats);
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+    std::vector<Counter> counters(seats_used.size());
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < seats_used.size(); ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            Counter c;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                c.succeeded += primitive.op(table, seats_used[t]);
+                c.ops++;
+            }
+            counters[t] = c;
+        });
+        pin(threads.back(), cpus, t);
+    }
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    std::uint64_t ops = 0, succeeded = 0;
+    for (auto& c : counters)
+    {
+        ops += c.ops;
+        succeeded += c.succeeded;
+    }
+    if (ops == 0)
+        return { 0.0, 0.0 };
+    return { elapsed * seats_used.size() / ops, 100.0 * succeeded / ops };
+}
+
+void report(const char* primitive, const std::string& scenario, std::size_t threads, std::pair<double, double> result)
+{
+    std::cout << std::left << std::setw(16) << primitive << std::setw(20) << scenario << std::right
+              << std::setw(8) << threads << std::setw(12) << std::fixed << std::setprecision(1) << result.first
+              << std::setw(10) << result.second << "\n";
+}
+
+// Two threads on different cores hand one fork back and forth: through the
+// Fork's mutex and condition variable, and through a bare atomic as the floor.
+double pingpong_fork(std::chrono::milliseconds duration, const std::vector<int>& cpus)
+{
+    Fork fork;
+    int turn = 0;
+    bool stop = false;
+    std::uint64_t handoffs[2] = {0, 0};
+
+    auto player = [&](int me)
+    {
+        std::unique_lock<std::mutex> lk(fork.mutex);
+        while (true)
+        {
+            fork.cv.wait(lk, [&] { return turn == me || stop; });
+            if (stop)
+                return;
+            turn = 1 - me;
+            handoffs[me]++;
+            lk.unlock();
+            fork.cv.notify_one();
+            lk.lock();
+        }
+    };
+
+    auto start = Clock::now();
+    std::thread a(player, 0), b(player, 1);
+    pin(a, cpus, 0);
+    pin(b, cpus, 1);
+    std::this_thread::sleep_for(duration);
+    {
+        std::lock_guard<std::mutex> lk(fork.mutex);
+        stop = true;
+    }
+    fork.cv.notify_all();
+    a.join();
+    b.join();
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return elapsed / std::max<std::uint64_t>(1, handoffs[0] + handoffs[1]);
+}
+
+double pingpong_atomic(std::chrono::milliseconds duration, const std::vector<int>& cpus)
+{
+    alignas(64) std::atomic<int> turn{0};
+    std::atomic<bool> stop{false};
+    std::uint64_t handoffs[2] = {0, 0};
+
+    auto player = [&](int me)
+    {
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (turn.load(std::memory_order_acquire) != me)
+            {
+                // Sharing a core with the other player, spinning would only burn its time slice.
+                if (cpus.size() < 2)
+                    std::this_thread::yield();
+                continue;
+            }
+            turn.store(1 - me, std::memory_order_release);
+            handoffs[me]++;
+        }
+    };
+
+    auto start = Clock::now();
+    std::thread a(player, 0), b(player, 1);
+    pin(a, cpus, 0);
+    pin(b, cpus, 1);
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    a.join();
+    b.join();
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return elapsed / std::max<std::uint64_t>(1, handoffs[0] + handoffs[1]);
+}
+
+int main(int argc, char* argv[])
+{
+    std::chrono::milliseconds duration(200);
+    std::vector<int> cpus = usable_cpus();
+    std::size_t max_threads = std::max<std::size_t>(2, cpus.size());
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': duration = std::chrono::milliseconds(std::stol(optarg)); break;
+        case 'n': max_threads = std::max<std::size_t>(2, std::stoul(optarg)); break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-t ms_per_run] [-n max_threads]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::size_t> sweep;
+    for (std::size_t n = 2; n < max_threads; n *= 2)
+        sweep.push_back(n);
+    sweep.push_back(max_threads);
+
+    std::cout << cpus.size() << " usable cores\n\n";
+    std::cout << std::left << std::setw(16) << "primitive" << std::setw(20) << "scenario" << std::right
+              << std::setw(8) << "threads" << std::setw(12) << "ns/op" << std::setw(10) << "got both%" << "\n";
+
+    for (const auto& primitive : primitives)
+    {
+        report(primitive.name, "uncontended", 1, measure(primitive, 5, {0}, duration, cpus));
+        report(primitive.name, "2-way neighbours", 2, measure(primitive, 5, {0, 1}, duration, cpus));
+        for (std::size_t n : sweep)
+        {
+            std::vector<std::size_t> seats;
+            for (std::size_t s = 0; s < n; ++s)
+                seats.push_back(s);
+            report(primitive.name, "ring of " + std::to_string(n), n, measure(primitive, n, seats, duration, cpus));
+        }
+    }
+
+    std::cout << "\nping-pong between two cores (ns per handoff)\n";
+    std::cout << "  fork mutex + cv  " << std::setprecision(1) << pingpong_fork(duration, cpus) << "\n";
+    std::cout << "  atomic flag      " << pingpong_atomic(duration, cpus) << "\n";
+}
@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdlib.h>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <pthread.h>
+#include <unistd.h>
+
+// Stress test for the fork protocols: no thinking, no eating, millions of
+// meals, and after every acquisition two invariants are checked with atomics:
+//   - no fork has two owners (each fork records its owner with a CAS)
+//   - no two neighbours eat at the same time
+// A watchdog reports a run that stops making progress. On any failure the
+// last events of every philosopher, including attempts and the forks it
+// waits for, are merged by time and printed.
+//
+// Protocols, copied from their files:
+//   fork wait      lower fork first, cv.wait, mutexes held while eating (chandy_misra_method.cpp)
+//   wait_for       same order with cv.wait_for, as in deadlock.cpp
+//   waiter         Waiter::takeIfForkAvailable (waiter_method.cpp)
+//   request_forks  request_forks/release_forks (waiter_method.c)
+// and two known-bad ones to see the checks fire, only run when named:
+//   unlocked       tests and sets isTaken without the mutex, yielding in between
+//   left-first     deadlock.cpp's left-then-right order, deadlocks without sleeps
+//
+// ThreadSanitizer build (defaults to fewer meals, the checks use no fences):
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread stress.cpp -o stress_tsan
+// The checks themselves are race free; under TSan "waiter" reports the
+// unlocked isTaken reads in howMuchTaken(), which it copies as is.
+//
+// With fewer CPUs than philosophers a meal is too short to ever be preempted,
+// so an overlap would go unseen; there, and with -y, a philosopher yields the
+// CPU once while eating.
+//
+// Usage: stress [-s protocol] [-n philosophers] [-m meals_per_philosopher] [-w watchdog_seconds] [-y]
+
+#if defined(__SANITIZE_THREAD__)
+#define UNDER_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define UNDER_TSAN 1
+#endif
+#endif
+
+#ifdef UNDER_TSAN
+constexpr std::size_t default_meals = 10000;
+#else
+constexpr std::size_t default_meals = 1000000;
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+struct Fork
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool isTaken = false;
+
+    void takeFork()
+    {
+        isTaken = true;
+        cv.notify_one();
+    }
+
+    void putFork()
+    {
+        isTaken = false;
+        cv.notify_one();
+    }
+};
+
+struct Waiter
+{
+    Waiter (std::vector<Fork>& forks_) : forks(forks_) {}
+    bool takeIfForkAvailable(size_t idl, size_t idr, bool second_fork = false)
+    {
+        (void)idr;
+        if (howMuchTaken() == forks.size() - 1 and !second_fork)
+            return false;
+        std::lock_guard lk(forks[idl].mutex);
+        if (!forks[idl].isTaken)
+        {
+            forks[idl].takeFork();
+            return true;
+        }
+        return false;
+    }
+
+    void putFork(size_t id)
+    {
+        std::lock_guard lk(forks[id].mutex);
+        forks[id].putFork();
+    }
+
+private:
+    std::vector<Fork>& forks;
+
+    size_t howMuchTaken()
+    {
+        size_t counter = 0;
+        for (auto& i : forks)
+        {
+            if (i.isTaken)
+                counter++;
+        }
+        return counter;
+    }
+};
+
+enum Event : std::uint8_t { Attempt, Wait, Claim, Free, Eat, Done };
+const char* event_names[] = { "tries to eat", "waits for fork", "claims fork", "frees fork", "eats", "done eating" };
+
+// Last events of one philosopher. Entries are relaxed atomics so a dump can
+// read them while a deadlocked owner still exists, without upsetting TSan.
+struct alignas(64) Trace
+{
+    static constexpr std::size_t size = 64;
+    std::atomic<std::uint64_t> when[size];
+    std::atomic<std::uint64_t> what[size];
+    std::size_t next = 0;
+    std::atomic<std::uint64_t> meals{0};
+
+    void record(std::int64_t ns, Event event, std::size_t fork = 0)
+    {
+        std::size_t i = next++ % size;
+        when[i].store(ns, std::memory_order_relaxed);
+        what[i].store((meals.load(std::memory_order_relaxed) << 32) | (std::uint64_t(fork) << 8) | event | 0x80,
+                      std::memory_order_relaxed);
+    }
+};
+
+struct Seat
+{
+    std::unique_lock<std::mutex> first;     // held while eating by the fork wait/wait_for protocols
+    std::unique_lock<std::mutex> second;
+};
+
+struct Table
+{
+    std::size_t seats;
+    std::vector<Fork> forks;
+    Waiter waiter;
+    pthread_mutex_t waiter_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<int> forks_taken;
+    std::vector<Seat> held;
+
+    // The checks, independent of whatever the protocol uses.
+    std::vector<std::atomic<int>> owner;
+    std::vector<std::atomic<bool>> eating;
+    std::vector<Trace> traces;
+
+    bool yieldWhileEating = false;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> failed{false};
+    std::string failure;
+
+    explicit Table(std::size_t seats)
+        : seats(seats), forks(seats), waiter(forks), forks_taken(seats, 0), held(seats), owner(seats), eating(seats), traces(seats)
+    {
+        for (auto& o : owner)
+            o = -1;
+    }
+    ~Table() { pthread_mutex_destroy(&waiter_mutex); }
+
+    std::size_t left(std::size_t seat) const { return seat; }
+    std::size_t right(std::size_t seat) const { return (seat + 1) % seats; }
+
+    void fail(const std::string& why)
+    {
+        if (!failed.exchange(true))
+            failure = why;
+        stop = true;
+    }
+};
+
+std::int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+bool fork_wait_take(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    Fork& firstForkRef = table.forks[std::min(leftForkIndex, rightForkIndex)];
+    Fork& secondForkRef = table.forks[std::max(leftForkIndex, rightForkIndex)];
+    Seat& s = table.held[seat];
+
+    table.traces[seat].record(now_ns(), Wait, &firstForkRef - table.forks.data());
+    s.first = std::unique_lock<std::mutex>(firstForkRef.mutex);
+    while (firstForkRef.isTaken)
+        firstForkRef.cv.wait(s.first);
+    firstForkRef.takeFork();
+
+    table.traces[seat].record(now_ns(), Wait, &secondForkRef - table.forks.data());
+    s.second = std::unique_lock<std::mutex>(secondForkRef.mutex);
+    while (secondForkRef.isTaken)
+        secondForkRef.cv.wait(s.second);
+    secondForkRef.takeFork();
+    return true;
+}
+
+void fork_wait_put(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    Fork& firstForkRef = table.forks[std::min(leftForkIndex, rightForkIndex)];
+    Fork& secondForkRef = table.forks[std::max(leftForkIndex, rightForkIndex)];
+    Seat& s = table.held[seat];
+
+    firstForkRef.putFork();
+    s.first.unlock();
+    firstForkRef.cv.notify_one();
+
+    secondForkRef.putFork();
+    s.second.unlock();
+    secondForkRef.cv.notify_one();
+}
+
+bool timed_take(Table& table, std::size_t seat, Fork& firstFork, Fork& secondFork)
+{
+    Seat& s = table.held[seat];
+    table.traces[seat].record(now_ns(), Wait, &firstFork - table.forks.data());
+    s.first = std::unique_lock<std::mutex>(firstFork.mutex);
+    if (!firstFork.cv.wait_for(s.first, std::chrono::milliseconds(1000), [&] { return !firstFork.isTaken; }))
+    {
+        s.first.unlock();
+        return false;
+    }
+    firstFork.takeFork();
+
+    table.traces[seat].record(now_ns(), Wait, &secondFork - table.forks.data());
+    s.second = std::unique_lock<std::mutex>(secondFork.mutex);
+    if (!secondFork.cv.wait_for(s.second, std::chrono::milliseconds(1000), [&] { return !secondFork.isTaken; }))
+    {
+        s.second.unlock();
+        firstFork.putFork();
+        s.first.unlock();
+        firstFork.cv.notify_one();
+        return false;
+    }
+    secondFork.takeFork();
+    return true;
+}
+
+bool wait_for_take(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+    return timed_take(table, seat, table.forks[std::min(leftForkIndex, rightForkIndex)], table.forks[std::max(leftForkIndex, rightForkIndex)]);
+}
+
+bool left_first_take(Table& table, std::size_t seat)
+{
+    return timed_take(table, seat, table.forks[table.left(seat)], table.forks[table.right(seat)]);
+}
+
+void timed_put(Table& table, std::size_t seat)
+{
+    // Whichever order timed_take used, s.first holds the first fork's mutex.
+    Seat& s = table.held[seat];
+    Fork& leftFork = table.forks[table.left(seat)];
+    Fork& rightFork = table.forks[table.right(seat)];
+    Fork& firstFork = s.first.mutex() == &leftFork.mutex ? leftFork : rightFork;
+    Fork& secondFork = &firstFork == &leftFork ? rightFork : leftFork;
+
+    secondFork.putFork();
+    s.second.unlock();
+    secondFork.cv.notify_one();
+
+    firstFork.putFork();
+    s.first.unlock();
+    firstFork.cv.notify_one();
+}
+
+bool waiter_take(Table& table, std::size_t seat)
+{
+    std::size_t leftForkIndex = table.left(seat);
+    std::size_t rightForkIndex = table.right(seat);
+
+    if (!table.waiter.takeIfForkAvailable(leftForkIndex, rightForkIndex))
+        return false;
+    if (!table.waiter.takeIfForkAvailable(rightForkIndex, leftForkIndex, true))
+    {
+        table.waiter.putFork(leftForkIndex);
+        return false;
+    }
+    return true;
+}
+
+void waiter_put(Table& table, std::size_t seat)
+{
+    table.waiter.putFork(table.left(seat));
+    table.waiter.putFork(table.right(seat));
+}
+
+bool request_forks(Table& table, std::size_t seat)
+{
+    int leftForkIndex = table.left(seat);
+    int rightForkIndex = table.right(seat);
+    pthread_mutex_lock(&table.waiter_mutex);
+    if (table.forks_taken[leftForkIndex] == 0 && table.forks_taken[rightForkIndex] == 0)
+    {
+        table.forks_taken[leftForkIndex] = 1;
+        table.forks_taken[rightForkIndex] = 1;
+        pthread_mutex_unlock(&table.waiter_mutex);
+        return true;
+    }
+    pthread_mutex_unlock(&table.waiter_mutex);
+    return false;
+}
+
+void release_forks(Table& table, std::size_t seat)
+{
+    pthread_mutex_lock(&table.waiter_mutex);
+    table.forks_taken[table.left(seat)] = 0;
+    table.forks_taken[table.right(seat)] = 0;
+    pthread_mutex_unlock(&table.waiter_mutex);
+}
+
+// Deliberately broken: check-then-act on isTaken with no lock at all.
+bool unlocked_take(Table& table, std::size_t seat)
+{
+    Fork& leftFork = table.forks[table.left(seat)];
+    Fork& rightFork = table.forks[table.right(seat)];
+    if (leftFork.isTaken || rightFork.isTaken)
+        return false;
+    // Widens the window between check and set, so the race shows even on one CPU.
+    std::this_thread::yield();
+    leftFork.isTaken = true;
+    rightFork.isTaken = true;
+    return true;
+}
+
+void unlocked_put(Table& table, std::size_t seat)
+{
+    table.forks[table.left(seat)].isTaken = false;
+    table.forks[table.right(seat)].isTaken = false;
+}
+
+struct Protocol
+{
+    const char* name;
+    bool (*take)(Table&, std::size_t);
+    void (*put)(Table&, std::size_t);
+    bool knownBad;
+};
+
+const Protocol protocols[] = {
+    { "fork wait", fork_wait_take, fork_wait_put, false },
+    { "wait_for", wait_for_take, timed_put, false },
+    { "waiter", waiter_take, waiter_put, false },
+    { "request_forks", request_forks, release_forks, false },
+    { "unlocked", unlocked_take, unlocked_put, true },
+    { "left-first", left_first_take, timed_put, true },
+};
+
+void claim(Table& table, std::size_t seat, std::size_t fork, Trace& trace)
+{
+    trace.record(now_ns(), Claim, fork);
+    int expected = -1;
+    if (!table.owner[fork].compare_exchange_strong(expected, static_cast<int>(seat)))
+        table.fail("philosopher " + std::to_string(seat + 1) + " got fork #" + std::to_string(fork)
+                   + " while philosopher " + std::to_string(expected + 1) + " still owns it");
+}
+
+void unclaim(Table& table, std::size_t seat, std::size_t fork, Trace& trace)
+{
+    trace.record(now_ns(), Free, fork);
+    int expected = static_cast<int>(seat);
+    if (!table.owner[fork].compare_exchange_strong(expected, -1))
+        table.fail("philosopher " + std::to_string(seat + 1) + " put down fork #" + std::to_string(fork)
+                   + " owned by philosopher " + std::to_string(expected + 1));
+}
+
+void philosopher(Table& table, const Protocol& protocol, std::size_t seat, std::size_t meals)
+{
+    Trace& trace = table.traces[seat];
+    std::size_t leftNeighbour = (seat + table.seats - 1) % table.seats;
+    std::size_t rightNeighbour = (seat + 1) % table.seats;
+
+    while (trace.meals.load(std::memory_order_relaxed) < meals && !table.stop.load(std::memory_order_relaxed))
+    {
+        trace.record(now_ns(), Attempt);
+        if (!protocol.take(table, seat))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        claim(table, seat, table.left(seat), trace);
+        claim(table, seat, table.right(seat), trace);
+
+        // Store-then-load on both sides: of two overlapping neighbours at least one sees the other.
+        table.eating[seat].store(true);
+        trace.record(now_ns(), Eat);
+        if (table.eating[leftNeighbour].load() || table.eating[rightNeighbour].load())
+            table.fail("philosopher " + std::to_string(seat + 1) + " eats next to an eating neighbour");
+        if (table.yieldWhileEating)
+            std::this_thread::yield();
+        table.eating[seat].store(false);
+        trace.record(now_ns(), Done);
+
+        unclaim(table, seat, table.left(seat), trace);
+        unclaim(table, seat, table.right(seat), trace);
+        protocol.put(table, seat);
+        trace.meals.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Prints the last few events of every philosopher, merged by time, so that a
+// fast philosopher cannot push a stuck one out of the dump.
+void dump(Table& table)
+{
+    struct Entry { std::uint64_t when; std::uint64_t what; std::size_t seat; };
+    auto byTime = [](const Entry& a, const Entry& b) { return a.when < b.when; };
+    const std::size_t perPhilosopher = 8;
+
+    std::vector<Entry> entries;
+    for (std::size_t seat = 0; seat < table.seats; ++seat)
+    {
+        std::vector<Entry> own;
+        for (std::size_t i = 0; i < Trace::size; ++i)
+        {
+            std::uint64_t what = table.traces[seat].what[i].load(std::memory_order_relaxed);
+            if (what)
+                own.push_back({ table.traces[seat].when[i].load(std::memory_order_relaxed), what, seat });
+        }
+        std::sort(own.begin(), own.end(), byTime);
+        entries.insert(entries.end(), own.end() - std::min(own.size(), perPhilosopher), own.end());
+    }
+    std::sort(entries.begin(), entries.end(), byTime);
+    if (entries.empty())
+        return;
+
+    std::cerr << "last " << perPhilosopher << " events of each philosopher (ns relative to the last one):\n";
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        const Entry& e = entries[i];
+        Event event = static_cast<Event>(e.what & 0x7f);
+        std::cerr << std::setw(10) << std::int64_t(e.when - entries.back().when)
+                  << "  philosopher " << e.seat + 1 << " meal " << (e.what >> 32) << " " << event_names[event];
+        if (event == Wait || event == Claim || event == Free)
+            std::cerr << " #" << ((e.what >> 8) & 0xffff);
+        std::cerr << "\n";
+    }
+}
+
+bool run(const Protocol& protocol, std::size_t seats, std::size_t meals, std::chrono::seconds watchdog, bool yieldWhileEating)
+{
+    Table table(seats);
+    table.yieldWhileEating = yieldWhileEating;
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (std::size_t seat = 0; seat < seats; ++seat)
+        threads.emplace_back(philosopher, std::ref(table), std::cref(protocol), seat, meals);
+
+    // Watchdog: every philosopher that still has meals left must make progress.
+    std::vector<std::uint64_t> last(seats, 0);
+    auto lastProgress = Clock::now();
+    while (!table.stop)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        bool progress = false, finished = true;
+        for (std::size_t seat = 0; seat < seats; ++seat)
+        {
+            std::uint64_t m = table.traces[seat].meals.load(std::memory_order_relaxed);
+            progress |= m != last[seat];
+            finished &= m >= meals;
+            last[seat] = m;
+        }
+        if (finished)
+            break;
+        if (progress)
+            lastProgress = Clock::now();
+        else if (Clock::now() - lastProgress > watchdog)
+        {
+            std::cerr << protocol.name << ": FAILED, no meal in " << watchdog.count() << " s (deadlock?)\n";
+            dump(table);
+            // The philosophers are stuck and cannot be joined.
+            std::cerr.flush();
+            std::_Exit(EXIT_FAILURE);
+        }
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    std::uint64_t total = 0;
+    for (auto& trace : table.traces)
+        total += trace.meals;
+
+    if (table.failed)
+    {
+        std::cout << protocol.name << ": FAILED after " << total << " meals: " << table.failure << "\n";
+        std::cout.flush();
+        dump(table);
+        return false;
+    }
+    std::cout << protocol.name << ": OK, " << total << " meals in " << std::fixed << std::setprecision(2)
+              << elapsed.count() << " s (" << std::setprecision(0) << total / elapsed.count() << " meals/s)\n";
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string only;
+    std::size_t seats = 5;
+    std::size_t meals = default_meals;
+    std::chrono::seconds watchdog(5);
+
+    int opt;
+    bool yieldWhileEating = false;
+    while ((opt = getopt(argc, argv, "s:n:m:w:y")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': only = optarg; break;
+        case 'n': seats = std::max<std::size_t>(2, std::stoul(optarg)); break;
+        case 'm': meals = std::stoul(optarg); break;
+        case 'w': watchdog = std::chrono::seconds(std::stol(optarg)); break;
+        case 'y': yieldWhileEating = true; break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-s protocol] [-n philosophers] [-m meals_per_philosopher] [-w watchdog_seconds] [-y]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    yieldWhileEating |= std::thread::hardware_concurrency() < seats;
+
+    bool ok = true, found = false;
+    for (const auto& protocol : protocols)
+    {
+        if (only.empty() ? protocol.knownBad : only != protocol.name)
+            continue;
+        found = true;
+        ok &= run(protocol, seats, meals, watchdog, yieldWhileEating);
+    }
+    if (!found)
+    {
+        std::cerr << "Unknown protocol " << only << "\n";
+        return EXIT_FAILURE;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}